@@ -0,0 +1,311 @@
+// loopmonitor 库：全局配置的唯一定义与所有冷路径
+// 头文件里的宏/守卫只做比较和分支，超标后才跳到这里（cold 函数由编译器放进 .text.unlikely）
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <execinfo.h>
+#include <mutex>
+#include "DynamicLoopCheck.h"
+
+namespace LoopMonitorConfig {
+    std::atomic<uint64_t> LOOP_WARN_THRESHOLD = 1000000;
+    std::atomic<bool> WARN_ONCE_PER_PROCESS = true;
+    bool ENABLE_STACK_TRACE = true;
+    bool ENABLE_LOOP_BREAK = false;
+}
+
+void printLoopStackTrace() {
+    if (!LoopMonitorConfig::ENABLE_STACK_TRACE) return;
+
+    void* callstack[16];
+    int frameNum = backtrace(callstack, 16);
+    char** funcNames = backtrace_symbols(callstack, frameNum);
+    if (!funcNames) return;
+
+    {
+        auto out = LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::StackTrace, LoopMonitor::LoopEventLevel::Warning);
+        out << "\n===== LOOP OVERFLOW STACK TRACE =====\n";
+        for (int i = 0; i < frameNum; ++i) {
+            out << "[" << i << "] " << funcNames[i] << "\n";
+        }
+        out << "=====================================\n";
+    }
+    free(funcNames);
+}
+
+void loopWarn(const std::string& loopName, uint64_t loopSize, uint64_t threshold, bool withStackTrace) {
+    static std::mutex warnMutex;
+    std::lock_guard<std::mutex> lock(warnMutex);
+    LOOP_PROBE3(loop_warn, loopName.c_str(), loopSize, threshold);
+
+    if (LoopMonitorConfig::WARN_ONCE_PER_PROCESS) {
+        auto now = std::chrono::system_clock::now();
+        auto nowT = std::chrono::system_clock::to_time_t(now);
+        LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Warn, LoopMonitor::LoopEventLevel::Warning)
+            << "[DYNAMIC_LOOP_WARN] " << ctime(&nowT)
+            << "LoopName: " << loopName << "\n"
+            << "DynamicCount: " << loopSize << " | Threshold: " << threshold;
+
+        if (withStackTrace) printLoopStackTrace();
+    }
+}
+
+namespace LoopMonitor {
+
+void recordLoopSample(LoopSite& site, uint64_t loopSize, uint32_t weight) {
+    auto& stats = site.localStats();
+    const uint64_t seq = stats.samples.fetch_add(1, std::memory_order_relaxed);
+    stats.invocations.fetch_add(weight, std::memory_order_relaxed);
+    stats.iterations.fetch_add(loopSize * weight, std::memory_order_relaxed);
+    atomicMaxRelaxed(stats.maxN, loopSize);
+    stats.histogram.record(loopSize, weight);
+    if (LoopMonitorConfig::ENABLE_ADAPTIVE_THRESHOLD.load(std::memory_order_relaxed)) [[unlikely]] {
+        adaptiveObserve(site, seq);
+    }
+}
+
+bool onLoopSizeViolation(LoopSite& site, uint64_t loopSize, uint64_t threshold) {
+    auto& stats = site.localStats();
+    stats.violations.fetch_add(1, std::memory_order_relaxed);
+    atomicMaxRelaxed(stats.maxN, loopSize);
+    LOOP_PROBE4(loop_violation, site.id, loopSize, threshold, site.name);
+    // 本轮已告警的站点只计数
+    if (claimLoopWarn(site)) {
+        if (LoopMonitorConfig::ENABLE_REALTIME_WARN.load(std::memory_order_relaxed)) {
+            loopWarnRealtime(site, loopSize, threshold, __builtin_return_address(0));
+        } else {
+            loopWarn(site.name, loopSize, threshold);
+        }
+    }
+    debitLoopRequest(site, loopSize);
+    return true;
+}
+
+bool onLoopTimeViolation(LoopSite& site, uint64_t loopSize, uint64_t budgetNs) {
+    site.localStats().predictedOverruns.fetch_add(1, std::memory_order_relaxed);
+    // 以预算内可执行的迭代数作为本次的等效阈值
+    const uint64_t limit = loopPredictedIterationLimit(site, budgetNs);
+    LOOP_PROBE4(loop_violation, site.id, loopSize, limit, site.name);
+    if (claimLoopWarn(site)) {
+        if (LoopMonitorConfig::ENABLE_REALTIME_WARN.load(std::memory_order_relaxed)) {
+            loopWarnRealtime(site, loopSize, limit, __builtin_return_address(0));
+        } else {
+            const uint64_t costQ16 = site.nsPerIterQ16.load(std::memory_order_relaxed);
+            loopLog(LoopEventCategory::Warn, LoopEventLevel::Warning)
+                << "[LOOP_TIME_PREDICT] LoopName: " << site.name << " | N: " << loopSize
+                << " | ns/Iter: " << static_cast<double>(costQ16) / 65536.0
+                << " | Predicted(ms): " << static_cast<double>(costQ16) / 65536.0 * loopSize / 1e6
+                << " | Budget(ms): " << budgetNs / 1000000;
+            loopWarn(site.name, loopSize, limit);
+        }
+    }
+    debitLoopRequest(site, loopSize);
+    return true;
+}
+
+void reportNegativeLoopSize(LoopSite& site, int64_t value) {
+    site.localStats().violations.fetch_add(1, std::memory_order_relaxed);
+    // 本轮已告警的站点只计数
+    if (!claimLoopWarn(site)) return;
+    if (LoopMonitorConfig::ENABLE_REALTIME_WARN.load(std::memory_order_relaxed)) {
+        loopWarnRealtime(site, static_cast<uint64_t>(value), 0, __builtin_return_address(0),
+                         LoopRealtimeEventKind::NegativeSize);
+        return;
+    }
+    loopLog(LoopEventCategory::Warn, LoopEventLevel::Warning)
+        << "[DYNAMIC_LOOP_WARN] LoopName: " << site.name << " | 循环次数为负数: " << value << "（按 0 处理）";
+}
+
+uint64_t onLoopClamp(LoopSite& site, uint64_t loopSize, uint64_t cap) {
+    auto& stats = site.localStats();
+    stats.truncations.fetch_add(1, std::memory_order_relaxed);
+    stats.truncatedIterations.fetch_add(loopSize - cap, std::memory_order_relaxed);
+    // MaxN/TotalN/直方图都记截断后实际执行的规模，原始 N 只体现在 TruncatedN 中
+    LOOP_PROBE4(loop_clamp, site.id, loopSize, cap, site.name);
+    if (claimLoopClampNotice(site)) {
+        if (LoopMonitorConfig::ENABLE_REALTIME_WARN.load(std::memory_order_relaxed)) {
+            loopWarnRealtime(site, loopSize, cap, __builtin_return_address(0), LoopRealtimeEventKind::Clamp);
+        } else {
+            loopLog(LoopEventCategory::Warn, LoopEventLevel::Warning)
+                << "[LOOP_CLAMP] LoopName: " << site.name << " | N: " << loopSize << " | Cap: " << cap
+                << " | 跳过: " << loopSize - cap;
+        }
+    }
+    return cap;
+}
+
+void reportLoopBreak(const char* message) {
+    if (LoopMonitorConfig::ENABLE_REALTIME_WARN.load(std::memory_order_relaxed)) {
+        loopBreakRealtime(message, __builtin_return_address(0));
+        return;
+    }
+    loopLog(LoopEventCategory::Break, LoopEventLevel::Error) << message;
+}
+
+void onLoopCountOverflow(LoopSite& site, uint64_t count) {
+    const uint64_t threshold = LoopMonitorConfig::LOOP_WARN_THRESHOLD.load(std::memory_order_relaxed);
+    // 计数刚越过阈值时记一次超标（之后每次迭代仍会进入这里）
+    if (count == threshold + 1) {
+        site.localStats().violations.fetch_add(1, std::memory_order_relaxed);
+        LOOP_PROBE4(loop_violation, site.id, count, threshold, site.name);
+    }
+    atomicMaxRelaxed(site.localStats().maxN, count);
+    if (!claimLoopWarn(site)) return;
+    if (LoopMonitorConfig::ENABLE_REALTIME_WARN.load(std::memory_order_relaxed)) {
+        loopWarnRealtime(site, count, threshold, __builtin_return_address(0));
+    } else {
+        loopWarn(site.name, count, threshold);
+    }
+}
+
+// 只输出 valid 中的计数项：打不开的事件读数恒为 0，输出出来会被当成真实的 0
+template <typename Out>
+void appendPerfCounters(Out& out, uint32_t valid, const PerfSample& d) {
+    if (valid & kPerfInstructions) out << " | Instructions: " << d.instructions;
+    if (valid & kPerfCycles) out << " | Cycles: " << d.cycles;
+    if ((valid & kPerfInstructions) && (valid & kPerfCycles)) {
+        out << " | IPC: " << (d.cycles ? static_cast<double>(d.instructions) / d.cycles : 0.0);
+    }
+    if (valid & kPerfLlcMisses) out << " | LLC-Misses: " << d.llcMisses;
+    if (valid & kPerfBranchMisses) out << " | Branch-Misses: " << d.branchMisses;
+    if (valid & kPerfCpuTime) out << " | CPU(ns): " << d.cpuNs;
+}
+
+void notePerfCounterMask(uint32_t valid) {
+    LOOP_PERF_RECORDED.fetch_or(valid, std::memory_order_relaxed);
+    const uint32_t missing = kPerfAllCounters & ~valid;
+    const uint32_t newlyMissing = missing & ~LOOP_PERF_MISSING.fetch_or(missing, std::memory_order_relaxed);
+    // CPU 时间只在软件模式采集，硬件模式下缺它不算异常；硬件事件每项只报一次
+    const uint32_t hardware = newlyMissing & kPerfHardwareCounters;
+    if (!hardware) return;
+    auto out = loopLog(LoopEventCategory::Perf, LoopEventLevel::Warning);
+    out << "[LOOP_PERF] 性能事件不可用，不计入统计:";
+    for (uint32_t i = 0; i < 4; ++i) {
+        if (hardware & (1u << i)) out << " " << kPerfCounterNames[i];
+    }
+    if (!(valid & kPerfHardwareCounters)) out << " | 已退化为线程 CPU 时间";
+}
+
+void printLoopPerfRecord(const LoopSite& site, uint64_t loopSize, uint64_t elapsedNs,
+                         PerfSource source, uint32_t valid, const PerfSample& d) {
+    auto out = loopLog(LoopEventCategory::Perf, LoopEventLevel::Warning);
+    out << "[LOOP_PERF] LoopName: " << site.name << " | N: " << loopSize
+        << " | Elapsed(ns): " << elapsedNs << " | Source: " << perfSourceName(source);
+    appendPerfCounters(out, valid, d);
+}
+
+void LoopGuard::enter() {
+    if (LOOP_WATCHDOG.running.load(std::memory_order_relaxed)) [[unlikely]] {
+        heartbeat_ = loopHeartbeatSlot();
+        prevBeat_ = heartbeat_->active.load(std::memory_order_relaxed);
+        heartbeat_->active.store(makeHeartbeat(site_.id, monotonicNs()), std::memory_order_relaxed);
+    }
+    if constexpr (LOOP_MONITOR_ALLOC_TRACKING) {
+        if (LoopMonitorConfig::ENABLE_ALLOC_TRACKING.load(std::memory_order_relaxed)) {
+            allocTracked_ = true;
+            enterLoopAllocFrame(allocFrame_);
+        }
+    }
+    // 未采样：只做阈值比较，不计时
+    if (weight_ != 0) {
+        if (LoopMonitorConfig::ENABLE_PERF_COUNTERS.load(std::memory_order_relaxed)) [[unlikely]] {
+            perf_ = &ThreadPerfCounters::local();
+            perfStart_ = perf_->read();
+        }
+        startNs_ = monotonicNs();
+    }
+    // 跨度不受采样影响，时间线上每次循环都可见
+    if (LoopMonitorConfig::ENABLE_LOOP_TRACE.load(std::memory_order_relaxed)) traceBeginTicks_ = loopTraceTicks();
+}
+
+void LoopGuard::leave() {
+    if (traceBeginTicks_) appendLoopTraceSpan(site_, loopSize_, traceBeginTicks_, loopTraceTicks());
+    // 嵌套守卫退出时恢复外层心跳
+    if (heartbeat_) heartbeat_->active.store(prevBeat_, std::memory_order_relaxed);
+    if (allocTracked_) leaveLoopAllocFrame(allocFrame_, site_, loopSize_, weight_);
+    if (weight_ == 0) return;
+    const uint64_t elapsedNs = monotonicNs() - startNs_;
+    auto& stats = site_.localStats();
+    stats.timedInvocations.fetch_add(weight_, std::memory_order_relaxed);
+    stats.totalNs.fetch_add(elapsedNs * weight_, std::memory_order_relaxed);
+    learnLoopIterationCost(site_, loopSize_, elapsedNs);
+    if (perf_) [[unlikely]] {
+        const PerfSample d = perf_->read() - perfStart_;
+        stats.perfSamples.fetch_add(weight_, std::memory_order_relaxed);
+        stats.instructions.fetch_add(d.instructions * weight_, std::memory_order_relaxed);
+        stats.cycles.fetch_add(d.cycles * weight_, std::memory_order_relaxed);
+        stats.llcMisses.fetch_add(d.llcMisses * weight_, std::memory_order_relaxed);
+        stats.branchMisses.fetch_add(d.branchMisses * weight_, std::memory_order_relaxed);
+        stats.cpuNs.fetch_add(d.cpuNs * weight_, std::memory_order_relaxed);
+        if (violated_ && !LoopMonitorConfig::ENABLE_REALTIME_WARN.load(std::memory_order_relaxed)) {
+            printLoopPerfRecord(site_, loopSize_, elapsedNs, perf_->source(), perf_->validMask(), d);
+        }
+    }
+}
+
+} // namespace LoopMonitor
+
+void setLoopWarnThreshold(uint64_t newThreshold) {
+    LoopMonitorConfig::LOOP_WARN_THRESHOLD.store(newThreshold);
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config) << "[LOOP_CONFIG] 阈值已更新为: " << newThreshold;
+}
+
+void setLoopPerfCounters(bool enable) {
+    LoopMonitorConfig::ENABLE_PERF_COUNTERS.store(enable);
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config) << "[LOOP_CONFIG] 性能计数: " << (enable ? "开启" : "关闭");
+}
+
+void dumpLoopSiteStats(std::ostream& os) {
+    os << "===== LOOP SITE STATS =====" << std::endl;
+    LoopMonitor::forEachLoopSite([&](const LoopMonitor::LoopSite& site) {
+        const auto s = LoopMonitor::snapshotLoopSite(site);
+        const uint32_t rate = site.sampleRate.load();
+        os << "[" << site.id << "] " << site.name
+           << " | Calls: " << s.invocations;
+        if (rate > 1) os << " (sampled 1/" << rate << ", samples " << s.samples << ")";
+        os << " | TotalN: " << s.iterations
+           << " | MaxN: " << s.maxN << " | Violations: " << s.violations
+           << " | Timed: " << s.timedInvocations << " | Time(ns): " << s.totalNs;
+        if (s.perfSamples) {
+            os << " | PerfSamples: " << s.perfSamples;
+            LoopMonitor::appendPerfCounters(os, LoopMonitor::loopPerfReportMask(),
+                                            {s.instructions, s.cycles, s.llcMisses, s.branchMisses, s.cpuNs});
+        }
+        if (const uint64_t costQ16 = site.nsPerIterQ16.load()) {
+            os << " | ns/Iter: " << static_cast<double>(costQ16) / 65536.0
+               << " | PredictedOverruns: " << s.predictedOverruns;
+        }
+        if (s.truncations) {
+            os << " | Truncations: " << s.truncations << " | TruncatedN: " << s.truncatedIterations;
+        }
+        if (s.allocGuards) {
+            os << " | Allocs: " << s.allocations << " | AllocBytes: " << s.allocBytes << " | Alloc/Iter: "
+               << (s.allocIterations ? static_cast<double>(s.allocations) / s.allocIterations : 0.0);
+        }
+        os << std::endl;
+    });
+    os << "===========================" << std::endl;
+}
+
+void setLoopSampleRate(const char* loopName, uint32_t rate) {
+    if (rate == 0) rate = 1;
+    LoopMonitor::updateLoopSiteOverride(loopName, [&](LoopMonitor::LoopSiteOverride& o) {
+        o.sampleRate = rate;
+    });
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config)
+        << "[LOOP_CONFIG] 采样率已更新: " << loopName << " = 1/" << rate;
+}
+
+void setLoopSiteClamp(const char* loopName, uint64_t cap) {
+    // 按名预置配置以 0 表示未设置，取消截断记为 UINT64_MAX
+    LoopMonitor::updateLoopSiteOverride(loopName, [&](LoopMonitor::LoopSiteOverride& o) {
+        o.clampLimit = cap ? cap : UINT64_MAX;
+    });
+    auto out = LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config);
+    out << "[LOOP_CONFIG] 站点截断上限: " << loopName << " = ";
+    if (cap) {
+        out << cap;
+    } else {
+        out << "不截断";
+    }
+}
@@ -2,76 +2,270 @@
 #include <iostream>
 #include <atomic>
 #include <string>
-#include <chrono>
-#include <cstdlib>
 #include <cstdint>
-#include <execinfo.h>
-#include <mutex>
+#include "LoopSink.h"
+#include "LoopProbes.h"
+#include "LoopSite.h"
+#include "LoopPerfCounters.h"
+#include "LoopAdaptiveThreshold.h"
+#include "LoopSampling.h"
+#include "LoopWatchdog.h"
+#include "LoopRangeCheck.h"
+#include "LoopBoundedIota.h"
+#include "LoopShmStats.h"
+#include "LoopCollector.h"
+#include "LoopRequestBudget.h"
+#include "LoopAllocTracking.h"
+#include "LoopRealtimeWarn.h"
+#include "LoopProfile.h"
+#include "LoopPersistentState.h"
+#include "LoopTimePrediction.h"
+#include "LoopChunkedRun.h"
+#include "LoopTrace.h"
 
-// 全局配置：可动态调整，支持从配置中心拉取
+// 全局配置：可动态调整，支持从配置中心拉取（定义见 DynamicLoopCheck.cpp）
 namespace LoopMonitorConfig {
     // 默认告警阈值：100万次（可改，根据业务调整）
-    std::atomic<uint64_t> LOOP_WARN_THRESHOLD = 1000000;
-    // 同进程仅首次超标告警（防刷屏，线上推荐）
-    std::atomic<bool> WARN_ONCE_PER_PROCESS = true;
+    extern std::atomic<uint64_t> LOOP_WARN_THRESHOLD;
+    // 告警开关：每个站点每轮仅首次超标告警（防刷屏，线上推荐）；resetLoopWarnFlag 开启新一轮，置 false 关闭告警输出
+    extern std::atomic<bool> WARN_ONCE_PER_PROCESS;
     // 是否开启栈回溯（测试/预发开，线上可关，减少开销）
-    bool ENABLE_STACK_TRACE = true;
+    extern bool ENABLE_STACK_TRACE;
     // 是否允许熔断（超标直接终止循环，线上谨慎开启）
-    bool ENABLE_LOOP_BREAK = false;
+    extern bool ENABLE_LOOP_BREAK;
 }
 
+// 头文件只保留比较与分支；告警、熔断、统计输出等冷路径在 loopmonitor 库（DynamicLoopCheck.cpp）中，
+// 标记 cold 后集中放在 .text.unlikely，宏展开在多少个编译单元都只多一条调用指令
+
 // 打印函数调用栈（精准定位超标循环）
-inline void printLoopStackTrace() {
-    if (!LoopMonitorConfig::ENABLE_STACK_TRACE) return;
+[[gnu::cold]] [[gnu::noinline]] void printLoopStackTrace();
+
+// 线程安全的告警器（输出串行；是否该由本线程告警由调用方经 claimLoopWarn 决定）
+[[gnu::cold]] [[gnu::noinline]] void loopWarn(const std::string& loopName, uint64_t loopSize,
+                                              uint64_t threshold = LoopMonitorConfig::LOOP_WARN_THRESHOLD.load(),
+                                              bool withStackTrace = true);
+
+namespace LoopMonitor {
+
+// 站点生效阈值：站点级（自适应/手动）优先，否则全局
+inline uint64_t effectiveLoopThreshold(const LoopSite& site) {
+    const uint64_t siteThreshold = site.threshold.load(std::memory_order_relaxed);
+    return siteThreshold ? siteThreshold
+                         : LoopMonitorConfig::LOOP_WARN_THRESHOLD.load(std::memory_order_relaxed);
+}
+
+// 截断处理：计数、提示（每站点每轮一次，与超标告警分开认领），返回截断后的规模 cap
+[[gnu::cold]] [[gnu::noinline]] uint64_t onLoopClamp(LoopSite& site, uint64_t loopSize, uint64_t cap);
+
+// 本轮是否由当前线程认领：已认领的只读一次即返回，
+// 否则一次 exchange 决出唯一的认领者，落选线程不碰任何锁
+inline bool claimLoopEpoch(std::atomic<uint64_t>& claimed) {
+    if (!LoopMonitorConfig::WARN_ONCE_PER_PROCESS.load(std::memory_order_relaxed)) return false;
+    const uint64_t epoch = LOOP_WARN_EPOCH.load(std::memory_order_relaxed);
+    if (claimed.load(std::memory_order_relaxed) == epoch) return false;
+    return claimed.exchange(epoch, std::memory_order_relaxed) != epoch;
+}
+
+// 本轮是否由当前线程为该站点发出超标告警
+inline bool claimLoopWarn(LoopSite& site) { return claimLoopEpoch(site.warnedEpoch); }
+
+// 本轮是否由当前线程为该站点发出截断提示
+inline bool claimLoopClampNotice(LoopSite& site) { return claimLoopEpoch(site.clampNoticeEpoch); }
+
+// 采样命中时的完整记录：按采样率放大计数，统计输出即为总量估计（直方图/自适应代码较大，不内联）
+[[gnu::noinline]] void recordLoopSample(LoopSite& site, uint64_t loopSize, uint32_t weight);
+
+// 超标处理：计数、告警（同步或实时路径）、扣减请求预算，恒返回 true
+// 告警与是否采样无关：每站点每轮的首次超标总是附带调用栈
+[[gnu::cold]] [[gnu::noinline]] bool onLoopSizeViolation(LoopSite& site, uint64_t loopSize, uint64_t threshold);
+
+// 预计耗时超出时间预算：计数、告警（同步或实时路径）、扣减请求预算，恒返回 true
+[[gnu::cold]] [[gnu::noinline]] bool onLoopTimeViolation(LoopSite& site, uint64_t loopSize, uint64_t budgetNs);
+
+// 熔断提示（宏与有界下标共用）
+[[gnu::cold]] [[gnu::noinline]] void reportLoopBreak(const char* message);
+
+// 循环内计数首次越过阈值（每次循环只记一次超标）
+[[gnu::cold]] [[gnu::noinline]] void onLoopCountOverflow(LoopSite& site, uint64_t count);
+
+// 超标循环的性能计数记录（附在告警之后，区分计算型/缓存型）
+[[gnu::cold]] [[gnu::noinline]] void printLoopPerfRecord(const LoopSite& site, uint64_t loopSize, uint64_t elapsedNs,
+                                                         PerfSource source, uint32_t valid, const PerfSample& d);
 
-    void* callstack[16];
-    int frameNum = backtrace(callstack, 16);
-    char** funcNames = backtrace_symbols(callstack, frameNum);
-    if (!funcNames) return;
+// 站点校验：阈值比较每次执行，完整记录按站点采样率抽样（默认 1/64，未命中时只有一次随机数比较）
+// sampleWeight 输出本次的放大倍数（0 表示未采样）
+inline bool checkLoopSize(LoopSite& site, uint64_t loopSize, uint32_t& sampleWeight) {
+    const uint32_t rate = site.sampleRate.load(std::memory_order_relaxed);
+    sampleWeight = shouldSampleLoop(rate) ? (rate ? rate : 1) : 0;
+    if (sampleWeight) recordLoopSample(site, loopSize, sampleWeight);
 
-    std::cerr << "\n===== LOOP OVERFLOW STACK TRACE =====" << std::endl;
-    for (int i = 0; i < frameNum; ++i) {
-        std::cerr << "[" << i << "] " << funcNames[i] << std::endl;
+    const uint64_t threshold = effectiveLoopThreshold(site);
+    LOOP_PROBE4(loop_enter, site.id, loopSize, threshold, site.name);
+    if (loopSize > threshold) [[unlikely]] return onLoopSizeViolation(site, loopSize, threshold);
+    // 按学习到的单次迭代耗时预测整段耗时（未设时间预算时只是一次判零）
+    if (const uint64_t budgetNs = effectiveLoopTimeBudget(site)) [[unlikely]] {
+        if (loopPredictedOverBudget(site, loopSize, budgetNs)) {
+            return onLoopTimeViolation(site, loopSize, budgetNs);
+        }
     }
-    std::cerr << "=====================================\n" << std::endl;
-    free(funcNames);
+    // 所属请求的累计预算（未安装请求时只是一次 thread_local 判空）
+    return debitLoopRequest(site, loopSize);
 }
 
-// 线程安全的告警器（避免多线程重复刷屏）
-inline void loopWarn(const std::string& loopName, uint64_t loopSize) {
-    static std::mutex warnMutex;
-    std::lock_guard<std::mutex> lock(warnMutex);
-
-    if (LoopMonitorConfig::WARN_ONCE_PER_PROCESS) {
-        auto now = std::chrono::system_clock::now();
-        auto nowT = std::chrono::system_clock::to_time_t(now);
-        std::cerr << "[DYNAMIC_LOOP_WARN] " << ctime(&nowT);
-        std::cerr << "LoopName: " << loopName << std::endl;
-        std::cerr << "DynamicCount: " << loopSize << " | Threshold: "
-                  << LoopMonitorConfig::LOOP_WARN_THRESHOLD << std::endl;
-
-        printLoopStackTrace();
-        LoopMonitorConfig::WARN_ONCE_PER_PROCESS = false;
+// 站点校验（返回 true 表示超标）
+inline bool checkLoopSize(LoopSite& site, uint64_t loopSize) {
+    uint32_t sampleWeight;
+    return checkLoopSize(site, loopSize, sampleWeight);
+}
+
+// 任意 N 来源的校验（整数/容器/范围），loopSize 输出实际规模
+// 定长容器与常量 N 同样走运行时校验：阈值、截断上限与统计都是运行时可调的，结果不随优化级别变化
+// Clamp 为 true 时（调用方按返回的 loopSize 执行循环）先按站点截断上限截断，再对截断后的规模校验
+template <bool Clamp = false, typename SiteFn, typename T>
+inline bool checkLoopSizeOf(SiteFn&& siteFn, const T& source, uint64_t& loopSize) {
+    if (!loopSizeOf(siteFn, source, loopSize)) return true;
+    LoopSite& site = siteFn();
+    if constexpr (Clamp) {
+        const uint64_t cap = site.clampLimit.load(std::memory_order_relaxed);
+        if (cap && loopSize > cap) [[unlikely]] loopSize = onLoopClamp(site, loopSize, cap);
+    }
+    return checkLoopSize(site, loopSize);
+}
+
+// 校验并返回规模（供循环直接使用，避免二次计算 size）
+template <typename SiteFn, typename T>
+inline uint64_t checkedLoopSize(SiteFn&& siteFn, const T& source) {
+    uint64_t loopSize = 0;
+    checkLoopSizeOf<true>(siteFn, source, loopSize);
+    return loopSize;
+}
+
+template <typename SiteFn, typename T>
+inline uint64_t boundedLoopSize(SiteFn&& siteFn, const T& source) {
+    uint64_t loopSize = 0;
+    if (checkLoopSizeOf<true>(siteFn, source, loopSize) && LoopMonitorConfig::ENABLE_LOOP_BREAK) [[unlikely]] {
+        reportLoopBreak("[LOOP_BREAK] 触发熔断，终止循环");
+        return 0;
     }
+    return loopSize;
 }
 
+// 作用域守卫：进入时校验 N，退出时记录耗时与性能计数
+// 内联部分只有校验与判断；心跳/分配追踪/计时/性能计数/跨度记录在库内的 enter()/leave()
+class LoopGuard {
+public:
+    LoopGuard(LoopSite& site, uint64_t loopSize)
+        : site_(site), loopSize_(loopSize), violated_(checkLoopSize(site, loopSize, weight_)) {
+        if (weight_ || LOOP_MONITOR_ALLOC_TRACKING || LOOP_WATCHDOG.running.load(std::memory_order_relaxed) ||
+            LoopMonitorConfig::ENABLE_LOOP_TRACE.load(std::memory_order_relaxed)) {
+            enter();
+        }
+    }
+
+    ~LoopGuard() {
+        LOOP_PROBE4(loop_exit, site_.id, loopSize_, violated_, site_.name);
+        if (weight_ || heartbeat_ || allocTracked_ || traceBeginTicks_) leave();
+    }
+
+    bool violated() const { return violated_; }
+
+    LoopGuard(const LoopGuard&) = delete;
+    LoopGuard& operator=(const LoopGuard&) = delete;
+
+private:
+    [[gnu::noinline]] void enter();
+    [[gnu::noinline]] void leave();
+
+    LoopSite& site_;
+    uint64_t loopSize_;
+    uint32_t weight_ = 0;
+    bool violated_;
+    ThreadPerfCounters* perf_ = nullptr;
+    PerfSample perfStart_;
+    uint64_t startNs_ = 0;
+    LoopHeartbeatSlot* heartbeat_ = nullptr;
+    uint64_t prevBeat_ = 0;
+    bool allocTracked_ = false;
+    LoopAllocFrame allocFrame_;
+    uint64_t traceBeginTicks_ = 0;   // 0 表示本次不记录跨度
+};
+
+} // namespace LoopMonitor
+
 /**
  * 1. 循环前校验（推荐优先用）
- * 适配：已知动态循环上限N（变量/函数返回值都可）
- * 作用：提前校验N，超标直接告警，避免无效循环
+ * 适配：已知动态循环上限N（变量/函数返回值都可），或直接传容器/范围（取其 size）
+ * 作用：提前校验N，超标直接告警，避免无效循环；有符号负数按超标处理
  */
 #define CHECK_LOOP_DYNAMIC_SIZE(N, LOOP_NAME) \
 do { \
-    const auto loopSize = static_cast<uint64_t>(N); \
-    if (loopSize > LoopMonitorConfig::LOOP_WARN_THRESHOLD.load()) { \
-        loopWarn(LOOP_NAME, loopSize); \
+    uint64_t loopSize; \
+    if (LoopMonitor::checkLoopSizeOf(LOOP_MONITOR_SITE_FN(LOOP_NAME), (N), loopSize)) { \
         if (LoopMonitorConfig::ENABLE_LOOP_BREAK) { \
-            std::cerr << "[LOOP_BREAK] 触发熔断，终止循环" << std::endl; \
+            LoopMonitor::reportLoopBreak("[LOOP_BREAK] 触发熔断，终止循环"); \
             break; \
         } \
     } \
 } while(0)
 
+/**
+ * 1.1 作用域守卫（校验 + 计时 + 性能计数）
+ * 适配：需要知道超标循环是计算型还是缓存抖动型
+ * 用法：{ LOOP_MONITOR_GUARD(N, "业务-xx循环"); for (...) {...} }
+ * 说明：setLoopPerfCounters(true) 后按线程打开 perf_event（指令/周期/LLC 未命中/分支未命中），
+ *       容器/虚拟机内不可用时自动退化为线程 CPU 时间；单个事件打不开时告警一次，报告中不输出该项
+ */
+#define LOOP_MONITOR_GUARD(N, LOOP_NAME) \
+    auto LOOP_MONITOR_CONCAT(loopSiteFn_, __LINE__) = LOOP_MONITOR_SITE_FN(LOOP_NAME); \
+    LoopMonitor::LoopGuard LOOP_MONITOR_CONCAT(loopGuard_, __LINE__)( \
+        LOOP_MONITOR_CONCAT(loopSiteFn_, __LINE__)(), \
+        LoopMonitor::loopSizeValue(LOOP_MONITOR_CONCAT(loopSiteFn_, __LINE__), (N)))
+
+/**
+ * 1.2 校验并取规模（表达式形式）
+ * 适配：容器/范围循环，size 只算一次
+ * 用法：for (uint64_t i = 0, n = LOOP_CHECKED_SIZE(items, "业务-xx循环"); i < n; ++i) {...}
+ * 说明：站点设了截断上限（setLoopSiteClamp）时返回 min(N, 上限)
+ */
+#define LOOP_CHECKED_SIZE(N, LOOP_NAME) \
+    LoopMonitor::checkedLoopSize(LOOP_MONITOR_SITE_FN(LOOP_NAME), (N))
+
+/**
+ * 1.3 有界下标范围（校验一次，下标为 uint64_t，熔断时为空范围）
+ * 用法：for (uint64_t i : LOOP_BOUNDED_IOTA(N, "业务-xx循环")) {...}
+ */
+#define LOOP_BOUNDED_IOTA(N, LOOP_NAME) \
+    LoopMonitor::boundedIota(LOOP_MONITOR_SITE_FN(LOOP_NAME), (N))
+
+/**
+ * 1.4 有界下标循环（按 N 分派 32/64 位下标）
+ * 用法：LOOP_FOR_BOUNDED_INDEX(N, "业务-xx循环", [&](auto i) { out[i] = in[i] * 2; });
+ */
+#define LOOP_FOR_BOUNDED_INDEX(N, LOOP_NAME, BODY) \
+    LoopMonitor::forEachBoundedIndex(LOOP_MONITOR_SITE_FN(LOOP_NAME), (N), BODY)
+
+/**
+ * 1.5 分片可续跑循环（超长循环分片执行，片间回调可让出 CPU / 保存进度 / 停止）
+ * 用法：uint64_t done = loadProgress();
+ *       done = LOOP_RUN_CHUNKED(N, "业务-数据同步循环", done, [&](uint64_t i) {...},
+ *                               [&](const LoopMonitor::LoopChunkProgress& p) { saveProgress(p.next); return !stopping; });
+ * 说明：分片大小按实测耗时调整到 CHUNK_TARGET_MS（默认 10ms）；每片单独计入看门狗预算，
+ *       并顺带学习站点的单次迭代耗时；返回值等于 N 表示已跑完
+ */
+#define LOOP_RUN_CHUNKED(N, LOOP_NAME, START_INDEX, BODY, CHECKPOINT) \
+    LoopMonitor::runLoopChunked(LOOP_MONITOR_SITE_FN(LOOP_NAME), (N), (START_INDEX), BODY, CHECKPOINT)
+
+/**
+ * 1.6 自动插桩退出标记（tools/LoopInstrument.cpp 跳过带此标记的循环）
+ * 用法：LOOP_MONITOR_SKIP for (...) {...}
+ */
+#if defined(__clang__)
+#define LOOP_MONITOR_SKIP [[clang::annotate("loop_monitor_skip")]]
+#else
+#define LOOP_MONITOR_SKIP
+#endif
+
 /**
  * 2. 循环内计数校验（兜底用）
  * 适配：未知循环上限、N嵌套过深无法提前获取
@@ -79,10 +273,11 @@ do { \
  */
 #define LOOP_DYNAMIC_COUNT_CHECK(CNT_VAR, LOOP_NAME) \
 do { \
-    if (++(CNT_VAR) > LoopMonitorConfig::LOOP_WARN_THRESHOLD.load()) { \
-        loopWarn(LOOP_NAME, CNT_VAR); \
+    LoopMonitor::loopCountHeartbeat(LOOP_MONITOR_SITE_FN(LOOP_NAME), ++(CNT_VAR)); \
+    if ((CNT_VAR) > LoopMonitorConfig::LOOP_WARN_THRESHOLD.load()) [[unlikely]] { \
+        LoopMonitor::onLoopCountOverflow(LOOP_MONITOR_SITE(LOOP_NAME), CNT_VAR); \
         if (LoopMonitorConfig::ENABLE_LOOP_BREAK) { \
-            std::cerr << "[LOOP_BREAK] 计数超标，强制终止" << std::endl; \
+            LoopMonitor::reportLoopBreak("[LOOP_BREAK] 计数超标，强制终止"); \
             break; \
         } \
     } \
@@ -92,15 +287,43 @@ do { \
  * 3. 阈值动态调整接口（运行时可改，无需重启）
  * 用法：setLoopWarnThreshold(5000000); // 调整阈值为500万
  */
-inline void setLoopWarnThreshold(uint64_t newThreshold) {
-    LoopMonitorConfig::LOOP_WARN_THRESHOLD.store(newThreshold);
-    std::cerr << "[LOOP_CONFIG] 阈值已更新为: " << newThreshold << std::endl;
-}
+void setLoopWarnThreshold(uint64_t newThreshold);
 
 /**
  * 4. 重置告警标记（测试环境复用）
- * 用法：resetLoopWarnFlag(); // 重置后可再次触发告警
+ * 用法：resetLoopWarnFlag(); // 重置后所有站点可再次触发一次告警
+ * 说明：只把告警轮次加一，不遍历站点
  */
 inline void resetLoopWarnFlag() {
+    LoopMonitor::LOOP_WARN_EPOCH.fetch_add(1, std::memory_order_relaxed);
     LoopMonitorConfig::WARN_ONCE_PER_PROCESS = true;
-}
\ No newline at end of file
+}
+
+/**
+ * 5. 性能计数开关（运行时可改）
+ * 用法：setLoopPerfCounters(true); // 之后进入的守卫开始采集
+ */
+void setLoopPerfCounters(bool enable);
+
+/**
+ * 6. 打印站点统计
+ * 用法：dumpLoopSiteStats(); // 输出每个站点的调用次数、最大N、超标次数、耗时、单次迭代耗时、性能计数、循环体分配
+ * 说明：采样站点的计数已按采样率放大（估计值），并标注采样率与实际样本数
+ */
+void dumpLoopSiteStats(std::ostream& os = std::cerr);
+
+/**
+ * 10. 站点采样率（热点路径限制监控开销）
+ * 用法：setLoopSampleRate("业务-数据同步循环", 1); // 全量记录（默认每 64 次调用完整记录 1 次）
+ * 说明：阈值比较、超标计数与超标告警（含调用栈）每次都执行；调用计数/直方图/计时只对采样命中的调用做，
+ *       按采样率放大为估计值；站点尚未执行时先记录，首次执行登记时生效
+ */
+void setLoopSampleRate(const char* loopName, uint32_t rate);
+
+/**
+ * 10.1 站点截断上限（过载时只处理前 K 项，而不是只告警或整段熔断）
+ * 用法：setLoopSiteClamp("业务-批量推送循环", 100000); // N 超过 10万时只执行前 10万项
+ * 说明：对按返回规模执行的 LOOP_CHECKED_SIZE、LOOP_BOUNDED_IOTA、LOOP_FOR_BOUNDED_INDEX、LOOP_RUN_CHUNKED 生效，
+ *       阈值校验与统计都按截断后的规模；截断次数与跳过的迭代数另计，每站点每轮提示一次（不占用超标告警）；传 0 取消截断
+ */
+void setLoopSiteClamp(const char* loopName, uint64_t cap);
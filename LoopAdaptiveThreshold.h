@@ -0,0 +1,178 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "LoopSite.h"
+#include "LoopSink.h"
+
+// 自适应阈值：按站点在线学习 N 的分布，预热后以 p99 × 倍数作为告警阈值
+namespace LoopMonitorConfig {
+    // 是否开启自适应阈值（开启后已学习站点不再使用全局阈值）
+    inline std::atomic<bool> ENABLE_ADAPTIVE_THRESHOLD = false;
+    // 预热样本数：样本不足时仍用全局阈值
+    inline std::atomic<uint64_t> ADAPTIVE_WARMUP_SAMPLES = 1000;
+    // 告警倍数：N > p99 × 倍数 才告警
+    inline std::atomic<double> ADAPTIVE_P99_MULTIPLIER = 4.0;
+}
+
+namespace LoopMonitor {
+
+// 每累计这么多次调用重新估计一次 p99（2 的幂，取模用掩码）
+inline constexpr uint64_t kAdaptiveRecomputeInterval = 1024;
+
+enum AdaptiveState : uint8_t {
+    kAdaptiveUnseeded = 0,   // 尚未合并已加载的基线
+    kAdaptiveWarming = 1,    // 预热中
+    kAdaptiveLearned = 2,    // 已学习，site.threshold 生效
+};
+
+// 已加载、尚未被站点认领的基线（按站点名哈希索引）
+struct LoopBaselineStore {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::vector<std::pair<int, uint64_t>>> pending;
+};
+
+inline LoopBaselineStore& loopBaselineStore() {
+    static LoopBaselineStore store;
+    return store;
+}
+
+// 由当前直方图重新计算站点阈值
+inline void recomputeAdaptiveThreshold(LoopSite& site) {
+    uint64_t counts[LoopSizeHistogram::kBuckets];
+    const uint64_t total = snapshotLoopHistogram(site, counts);
+    if (total < LoopMonitorConfig::ADAPTIVE_WARMUP_SAMPLES.load(std::memory_order_relaxed)) return;
+
+    const uint64_t p99 = histogramQuantile(counts, total, 0.99);
+    const double limit = std::ceil(static_cast<double>(p99 > 0 ? p99 : 1) *
+                                   LoopMonitorConfig::ADAPTIVE_P99_MULTIPLIER.load(std::memory_order_relaxed));
+    const uint64_t newThreshold = limit >= 1.8e19 ? UINT64_MAX : static_cast<uint64_t>(limit);
+    site.threshold.store(newThreshold, std::memory_order_relaxed);
+    if (site.adaptiveState.exchange(kAdaptiveLearned, std::memory_order_relaxed) != kAdaptiveLearned) {
+        loopLog(LoopEventCategory::Adaptive) << "[LOOP_ADAPTIVE] LoopName: " << site.name << " | Samples: " << total
+                                             << " | p99: " << p99 << " | Threshold: " << newThreshold;
+    }
+}
+
+// 首次参与自适应时合并重启前导出的基线
+inline void seedAdaptiveBaseline(LoopSite& site) {
+    uint8_t expected = kAdaptiveUnseeded;
+    if (!site.adaptiveState.compare_exchange_strong(expected, kAdaptiveWarming)) return;
+
+    auto& store = loopBaselineStore();
+    std::vector<std::pair<int, uint64_t>> buckets;
+    {
+        std::lock_guard<std::mutex> lock(store.mutex);
+        auto it = store.pending.find(site.nameHash);
+        if (it == store.pending.end()) return;
+        buckets = std::move(it->second);
+        store.pending.erase(it);
+    }
+    for (const auto& [idx, count] : buckets) {
+        site.stats.histogram.counts[idx].fetch_add(count, std::memory_order_relaxed);
+    }
+    recomputeAdaptiveThreshold(site);
+}
+
+// 热路径钩子：seq 为本次调用前的调用计数
+inline void adaptiveObserve(LoopSite& site, uint64_t seq) {
+    if (site.adaptiveState.load(std::memory_order_relaxed) == kAdaptiveUnseeded) [[unlikely]] {
+        seedAdaptiveBaseline(site);
+    }
+    if (((seq + 1) & (kAdaptiveRecomputeInterval - 1)) == 0) [[unlikely]] {
+        recomputeAdaptiveThreshold(site);
+    }
+}
+
+} // namespace LoopMonitor
+
+/**
+ * 7. 自适应阈值开关
+ * 用法：setLoopAdaptiveThreshold(true, 4.0); // 预热后按 p99 × 4 告警
+ * 说明：关闭时清除已学习的站点阈值，恢复剖析预置或全局阈值
+ */
+inline void setLoopAdaptiveThreshold(bool enable, double p99Multiplier = 4.0) {
+    LoopMonitorConfig::ADAPTIVE_P99_MULTIPLIER.store(p99Multiplier);
+    LoopMonitorConfig::ENABLE_ADAPTIVE_THRESHOLD.store(enable);
+    LoopMonitor::forEachLoopSite([&](LoopMonitor::LoopSite& site) {
+        if (enable) {
+            LoopMonitor::recomputeAdaptiveThreshold(site);
+        } else if (site.adaptiveState.load() == LoopMonitor::kAdaptiveLearned) {
+            // 回到剖析预置（未加载剖析时为 0，即全局阈值）
+            const LoopMonitor::LoopThresholdPresetFn preset = LoopMonitor::LOOP_THRESHOLD_PRESET.load();
+            site.threshold.store(preset ? preset(site.nameHash) : 0);
+            site.adaptiveState.store(LoopMonitor::kAdaptiveWarming);
+        }
+    });
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config)
+        << "[LOOP_CONFIG] 自适应阈值: " << (enable ? "开启" : "关闭") << " | p99倍数: " << p99Multiplier;
+}
+
+/**
+ * 8. 导出学习到的基线（重启后 loadLoopBaselines 续用）
+ * 格式：每行 "站点名<TAB>桶号:计数 ..."，仅写非零桶
+ * 用法：exportLoopBaselines("/var/lib/app/loop_baselines.txt");
+ */
+inline bool exportLoopBaselines(const std::string& path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) return false;
+    out << "# loop-baselines v1\n";
+    LoopMonitor::forEachLoopSite([&](const LoopMonitor::LoopSite& site) {
+        uint64_t counts[LoopMonitor::LoopSizeHistogram::kBuckets];
+        if (LoopMonitor::snapshotLoopHistogram(site, counts) == 0) return;
+        out << site.name << '\t';
+        for (int i = 0; i < LoopMonitor::LoopSizeHistogram::kBuckets; ++i) {
+            if (counts[i]) out << i << ':' << counts[i] << ' ';
+        }
+        out << '\n';
+    });
+    return static_cast<bool>(out);
+}
+
+/**
+ * 9. 加载基线（进程启动时调用；站点首次执行时合并，无需先注册）
+ * 用法：loadLoopBaselines("/var/lib/app/loop_baselines.txt");
+ */
+inline bool loadLoopBaselines(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) return false;
+    auto& store = LoopMonitor::loopBaselineStore();
+    std::string line;
+    size_t loaded = 0;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        const auto tab = line.find('\t');
+        if (tab == std::string::npos) continue;
+        std::vector<std::pair<int, uint64_t>> buckets;
+        std::istringstream fields(line.substr(tab + 1));
+        std::string field;
+        while (fields >> field) {
+            const auto colon = field.find(':');
+            if (colon == std::string::npos) continue;
+            const unsigned long idx = std::strtoul(field.c_str(), nullptr, 10);
+            if (idx >= LoopMonitor::LoopSizeHistogram::kBuckets) continue;
+            buckets.emplace_back(static_cast<int>(idx),
+                                 std::strtoull(field.c_str() + colon + 1, nullptr, 10));
+        }
+        std::lock_guard<std::mutex> lock(store.mutex);
+        store.pending[LoopMonitor::loopNameHash(std::string_view(line).substr(0, tab))] = std::move(buckets);
+        ++loaded;
+    }
+    // 已经跑过的站点立即重新合并
+    LoopMonitor::forEachLoopSite([](LoopMonitor::LoopSite& site) {
+        uint8_t state = site.adaptiveState.load();
+        if (state != LoopMonitor::kAdaptiveUnseeded) {
+            site.adaptiveState.compare_exchange_strong(state, LoopMonitor::kAdaptiveUnseeded);
+            LoopMonitor::seedAdaptiveBaseline(site);
+        }
+    });
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config) << "[LOOP_CONFIG] 已加载基线站点数: " << loaded;
+    return true;
+}
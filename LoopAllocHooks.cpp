@@ -0,0 +1,92 @@
+// 全局 operator new/delete 替换：只做线程本地计数，再转发给 malloc/free
+// 由 CMake 选项 LOOP_MONITOR_ALLOC_TRACKING 加入构建，未启用时不影响分配路径
+#include <cstdlib>
+#include <new>
+#include "LoopAllocTracking.h"
+
+namespace {
+
+void* allocOrThrow(std::size_t size) {
+    if (size == 0) size = 1;
+    for (;;) {
+        if (void* p = std::malloc(size)) {
+            LoopMonitor::noteLoopAllocation(size);
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* alignedAllocOrThrow(std::size_t size, std::align_val_t align) {
+    const auto alignment = static_cast<std::size_t>(align);
+    if (size == 0) size = 1;
+    size = (size + alignment - 1) & ~(alignment - 1);   // aligned_alloc 要求 size 为对齐的整数倍
+    for (;;) {
+        if (void* p = std::aligned_alloc(alignment, size)) {
+            LoopMonitor::noteLoopAllocation(size);
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void release(void* p) noexcept {
+    if (!p) return;
+    LoopMonitor::noteLoopFree();
+    std::free(p);
+}
+
+} // namespace
+
+void* operator new(std::size_t size) { return allocOrThrow(size); }
+void* operator new[](std::size_t size) { return allocOrThrow(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocOrThrow(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocOrThrow(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new(std::size_t size, std::align_val_t align) { return alignedAllocOrThrow(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align) { return alignedAllocOrThrow(size, align); }
+
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    try {
+        return alignedAllocOrThrow(size, align);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    try {
+        return alignedAllocOrThrow(size, align);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, std::size_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p); }
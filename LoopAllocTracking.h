@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "LoopSite.h"
+#include "LoopSink.h"
+
+// 循环体分配追踪：全局 operator new/delete 钩子（LoopAllocHooks.cpp）只做线程本地计数，
+// 守卫在进入/退出时各读一次计数，差值扣掉嵌套守卫的部分后记到最内层站点
+// 需以 -DLOOP_MONITOR_ALLOC_TRACKING=1 编译并链接 LoopAllocHooks.cpp（CMake 选项同名）
+#ifndef LOOP_MONITOR_ALLOC_TRACKING
+#define LOOP_MONITOR_ALLOC_TRACKING 0
+#endif
+
+namespace LoopMonitorConfig {
+    // 运行时开关（钩子的线程本地计数始终进行，此开关只控制守卫是否归属统计）
+    inline std::atomic<bool> ENABLE_ALLOC_TRACKING = LOOP_MONITOR_ALLOC_TRACKING != 0;
+    // 每次迭代平均分配次数达到该值即视为“循环体内分配”并告警（每站点一次）
+    inline std::atomic<double> ALLOC_PER_ITERATION_ALERT = 1.0;
+    // N 小于该值的循环不参与告警（初始化类小循环分配属正常）
+    inline std::atomic<uint64_t> ALLOC_ALERT_MIN_ITERATIONS = 1024;
+}
+
+namespace LoopMonitor {
+
+// 线程本地分配计数（常量初始化的平凡类型，钩子内访问无需 TLS 初始化检查）
+struct LoopAllocCounters {
+    uint64_t allocations;
+    uint64_t bytes;
+    uint64_t frees;
+};
+
+inline thread_local LoopAllocCounters LOOP_ALLOC_COUNTERS {0, 0, 0};
+
+// 钩子调用：当前线程计数 +1，无其他分支
+inline void noteLoopAllocation(size_t size) noexcept {
+    LoopAllocCounters& c = LOOP_ALLOC_COUNTERS;
+    ++c.allocations;
+    c.bytes += size;
+}
+
+inline void noteLoopFree() noexcept {
+    ++LOOP_ALLOC_COUNTERS.frees;
+}
+
+// 守卫的分配帧：构成线程内的守卫栈，用于把嵌套守卫的分配从外层扣除
+struct LoopAllocFrame {
+    LoopAllocFrame* parent = nullptr;
+    uint64_t startAllocations = 0;
+    uint64_t startBytes = 0;
+    uint64_t childAllocations = 0;
+    uint64_t childBytes = 0;
+};
+
+inline thread_local LoopAllocFrame* LOOP_ALLOC_FRAME = nullptr;
+
+inline void enterLoopAllocFrame(LoopAllocFrame& frame) {
+    const LoopAllocCounters& c = LOOP_ALLOC_COUNTERS;
+    frame.parent = LOOP_ALLOC_FRAME;
+    frame.startAllocations = c.allocations;
+    frame.startBytes = c.bytes;
+    LOOP_ALLOC_FRAME = &frame;
+}
+
+[[gnu::cold]] [[gnu::noinline]] inline void reportLoopBodyAllocation(LoopSite& site, uint64_t loopSize,
+                                                                       uint64_t allocations, uint64_t bytes) {
+    if (site.allocAlerted.exchange(true, std::memory_order_relaxed)) return;
+    loopLog(LoopEventCategory::Alloc, LoopEventLevel::Warning)
+        << "[LOOP_ALLOC] LoopName: " << site.name << " | N: " << loopSize
+        << " | Allocations: " << allocations << " | Bytes: " << bytes
+        << " | Alloc/Iter: " << static_cast<double>(allocations) / static_cast<double>(loopSize)
+        << "（循环体内存在堆分配）";
+}
+
+// 退出帧：本层净分配记到站点（按采样权重放大），总量上交给外层
+inline void leaveLoopAllocFrame(LoopAllocFrame& frame, LoopSite& site, uint64_t loopSize, uint32_t weight) {
+    const LoopAllocCounters& c = LOOP_ALLOC_COUNTERS;
+    const uint64_t totalAllocations = c.allocations - frame.startAllocations;
+    const uint64_t totalBytes = c.bytes - frame.startBytes;
+    LOOP_ALLOC_FRAME = frame.parent;
+    if (frame.parent) {
+        frame.parent->childAllocations += totalAllocations;
+        frame.parent->childBytes += totalBytes;
+    }
+    const uint64_t ownAllocations = totalAllocations - frame.childAllocations;
+    const uint64_t ownBytes = totalBytes - frame.childBytes;
+    // 未采样的守卫也入栈（保证归属到最内层），但只有采样命中的才计入站点统计
+    if (weight) {
+        auto& stats = site.localStats();
+        stats.allocGuards.fetch_add(weight, std::memory_order_relaxed);
+        stats.allocIterations.fetch_add(loopSize * weight, std::memory_order_relaxed);
+        if (ownAllocations) {
+            stats.allocations.fetch_add(ownAllocations * weight, std::memory_order_relaxed);
+            stats.allocBytes.fetch_add(ownBytes * weight, std::memory_order_relaxed);
+        }
+    }
+    if (ownAllocations == 0) return;
+    if (loopSize >= LoopMonitorConfig::ALLOC_ALERT_MIN_ITERATIONS.load(std::memory_order_relaxed) &&
+        static_cast<double>(ownAllocations) >=
+            static_cast<double>(loopSize) * LoopMonitorConfig::ALLOC_PER_ITERATION_ALERT.load(std::memory_order_relaxed))
+        [[unlikely]] {
+        reportLoopBodyAllocation(site, loopSize, ownAllocations, ownBytes);
+    }
+}
+
+} // namespace LoopMonitor
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include "LoopSite.h"
+#include "LoopRangeCheck.h"
+
+// 有界下标范围：只校验一次 N，下标类型与规模匹配，避免 int 与 uint64_t 混比
+namespace LoopMonitor {
+
+// 熔断开启且超标时返回 0，循环直接不执行
+template <typename SiteFn, typename T>
+inline uint64_t boundedLoopSize(SiteFn&& siteFn, const T& source);
+
+// [0, N) 的 uint64_t 下标范围
+template <typename SiteFn, typename T>
+inline auto boundedIota(SiteFn&& siteFn, const T& source) {
+    return std::views::iota(uint64_t{0}, boundedLoopSize(siteFn, source));
+}
+
+// 运行期按 N 选择最窄下标类型：N 不超过 32 位时用 uint32_t 实例化循环体，利于向量化
+// body 需为泛型可调用对象，如 [&](auto i) {...}
+template <typename SiteFn, typename T, typename Body>
+inline void forEachBoundedIndex(SiteFn&& siteFn, const T& source, Body&& body) {
+    const uint64_t size = boundedLoopSize(siteFn, source);
+    if (size <= std::numeric_limits<uint32_t>::max()) [[likely]] {
+        const auto end = static_cast<uint32_t>(size);
+        for (uint32_t i = 0; i != end; ++i) body(i);
+    } else {
+        for (uint64_t i = 0; i != size; ++i) body(i);
+    }
+}
+
+} // namespace LoopMonitor
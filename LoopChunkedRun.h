@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include "LoopSite.h"
+#include "LoopWatchdog.h"
+#include "LoopBoundedIota.h"
+#include "LoopTimePrediction.h"
+
+// 分片续跑：超长循环按分片执行，片间调用检查点回调（让出 CPU、保存进度、决定是否继续），
+// 中断或重启后从最后完成的下标续跑；分片大小按实测耗时自动调整到目标时长
+namespace LoopMonitorConfig {
+    // 默认目标分片时长（毫秒）
+    inline std::atomic<uint64_t> CHUNK_TARGET_MS = 10;
+}
+
+namespace LoopMonitor {
+
+// 站点尚未学到单次迭代耗时时的首片大小
+inline constexpr uint64_t kLoopChunkInitialSize = 1024;
+// 相邻分片的最大缩放倍数（抑制耗时抖动引起的振荡）
+inline constexpr uint64_t kLoopChunkMaxScale = 4;
+
+// 每片完成后交给检查点回调的进度；已完成 [0, next)，续跑时把 next 作为起始下标传回
+struct LoopChunkProgress {
+    uint64_t next;
+    uint64_t total;
+    uint64_t chunkSize;   // 刚完成的分片迭代数
+    uint64_t chunkNs;     // 刚完成的分片耗时
+};
+
+inline uint64_t initialLoopChunkSize(const LoopSite& site, uint64_t targetNs) {
+    const uint64_t costQ16 = site.nsPerIterQ16.load(std::memory_order_relaxed);
+    if (costQ16 == 0) return kLoopChunkInitialSize;
+    const unsigned __int128 size = (static_cast<unsigned __int128>(targetNs) << 16) / costQ16;
+    return size == 0 ? 1 : size > UINT64_MAX ? UINT64_MAX : static_cast<uint64_t>(size);
+}
+
+// 按上一片的实测耗时把分片缩放到目标时长，单步缩放不超过 kLoopChunkMaxScale 倍
+inline uint64_t nextLoopChunkSize(uint64_t chunk, uint64_t elapsedNs, uint64_t targetNs) {
+    const uint64_t lower = std::max<uint64_t>(chunk / kLoopChunkMaxScale, 1);
+    const uint64_t upper = chunk > UINT64_MAX / kLoopChunkMaxScale ? UINT64_MAX : chunk * kLoopChunkMaxScale;
+    if (elapsedNs == 0) return upper;
+    const unsigned __int128 ideal = static_cast<unsigned __int128>(chunk) * targetNs / elapsedNs;
+    if (ideal < lower) return lower;
+    if (ideal > upper) return upper;
+    return static_cast<uint64_t>(ideal);
+}
+
+// 看门狗心跳：每片单独计入看门狗预算，退出（含异常）时恢复外层心跳
+struct LoopChunkHeartbeat {
+    LoopHeartbeatSlot* slot = nullptr;
+    uint64_t prevBeat = 0;
+
+    explicit LoopChunkHeartbeat(bool enabled) {
+        if (!enabled) return;
+        slot = loopHeartbeatSlot();
+        prevBeat = slot->active.load(std::memory_order_relaxed);
+    }
+    ~LoopChunkHeartbeat() { leave(); }
+
+    void enter(const LoopSite& site, uint64_t nowNs) {
+        if (slot) slot->active.store(makeHeartbeat(site.id, nowNs), std::memory_order_relaxed);
+    }
+    void leave() {
+        if (slot) slot->active.store(prevBeat, std::memory_order_relaxed);
+    }
+
+    LoopChunkHeartbeat(const LoopChunkHeartbeat&) = delete;
+    LoopChunkHeartbeat& operator=(const LoopChunkHeartbeat&) = delete;
+};
+
+// 从 startIndex 起分片执行 body(i)，i 为 uint64_t；checkpoint(const LoopChunkProgress&) 返回 false 即停止
+// 返回下一个待执行下标（等于 N 表示已完成）；N 超标且开启熔断时不执行，返回 startIndex
+template <typename SiteFn, typename T, typename Body, typename Checkpoint>
+uint64_t runLoopChunked(SiteFn&& siteFn, const T& source, uint64_t startIndex, Body&& body,
+                        Checkpoint&& checkpoint, uint64_t targetChunkNs = 0) {
+    const uint64_t total = boundedLoopSize(siteFn, source);
+    if (startIndex >= total) return startIndex;
+    LoopSite& site = siteFn();
+    const uint64_t targetNs = targetChunkNs ? targetChunkNs
+                                            : LoopMonitorConfig::CHUNK_TARGET_MS.load(std::memory_order_relaxed) * 1000000;
+    LoopChunkHeartbeat heartbeat(LOOP_WATCHDOG.running.load(std::memory_order_relaxed));
+    uint64_t chunk = initialLoopChunkSize(site, targetNs);
+    uint64_t next = startIndex;
+    while (next < total) {
+        const uint64_t end = next + std::min(chunk, total - next);
+        const uint64_t startNs = monotonicNs();
+        heartbeat.enter(site, startNs);
+        for (uint64_t i = next; i != end; ++i) body(i);
+        const uint64_t elapsedNs = monotonicNs() - startNs;
+        heartbeat.leave();
+        const uint64_t done = end - next;
+        next = end;
+        loopHeartbeatTick(next);
+        learnLoopIterationCost(site, done, elapsedNs);
+        chunk = nextLoopChunkSize(done, elapsedNs, targetNs);
+        if (!checkpoint(LoopChunkProgress{next, total, done, elapsedNs})) break;
+    }
+    return next;
+}
+
+} // namespace LoopMonitor
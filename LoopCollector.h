@@ -0,0 +1,208 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "LoopSite.h"
+#include "LoopSink.h"
+
+// 主机级汇总：各进程按周期把站点累计值打包，经 Unix 数据报发给 loop-collector，由汇总进程按 pid 求差
+// 发送非阻塞，对端缓冲满或未启动时直接丢弃本批（只记丢弃数），被监控进程不会被拖慢；
+// 累计值的下一批自然补上丢失的增量，另每隔若干周期全量重发一次，不再变化的站点也能补齐
+namespace LoopMonitorConfig {
+    // 上报周期（毫秒）
+    inline std::atomic<uint64_t> COLLECTOR_INTERVAL_MS = 1000;
+}
+
+namespace LoopMonitor {
+
+inline constexpr uint32_t kCollectorMagic = 0x4C504331;   // "LPC1"
+inline constexpr uint32_t kCollectorVersion = 3;
+inline constexpr size_t kCollectorNameLen = 64;
+// 每个数据报最多携带的站点数（约 7KB，远低于 Unix 数据报上限）
+inline constexpr uint32_t kCollectorBatchSites = 64;
+inline constexpr const char* kDefaultCollectorSocket = "/tmp/loopmon-collector.sock";
+// 每隔该周期数全量发送一次（其余周期只发有变化的站点）
+inline constexpr uint64_t kCollectorFullSyncPeriods = 10;
+
+struct LoopCollectorHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t pid;
+    uint32_t recordCount;
+    uint64_t batchSeq;        // 每个数据报 +1，收端据此统计丢包
+    uint64_t intervalNs;      // 本批覆盖的时长
+};
+
+// 站点自进程启动以来的累计值（汇总进程与同一 pid 上次收到的值求差）
+struct LoopCollectorRecord {
+    uint64_t nameHash;        // 汇总按哈希合并，名字只用于输出
+    char name[kCollectorNameLen];
+    uint64_t invocations;
+    uint64_t iterations;
+    uint64_t violations;
+    uint64_t timedInvocations;
+    uint64_t totalNs;
+    uint64_t maxN;
+};
+
+struct LoopCollectorClientState {
+    int fd = -1;
+    sockaddr_un addr {};
+    std::vector<LoopSiteSnapshot> prev;   // 下标 = 站点 id - 1
+    std::vector<char> buffer;
+    uint64_t batchSeq = 0;
+    uint64_t flushCount = 0;
+    uint64_t lastSendNs = 0;
+    std::atomic<uint64_t> sentBatches{0};
+    std::atomic<uint64_t> droppedBatches{0};
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    ~LoopCollectorClientState();
+};
+
+inline LoopCollectorClientState LOOP_COLLECTOR_CLIENT;
+
+inline void sendCollectorBatch(LoopCollectorClientState& st, uint32_t count, uint64_t intervalNs) {
+    auto* header = reinterpret_cast<LoopCollectorHeader*>(st.buffer.data());
+    header->magic = kCollectorMagic;
+    header->version = kCollectorVersion;
+    header->pid = static_cast<int32_t>(getpid());
+    header->recordCount = count;
+    header->batchSeq = ++st.batchSeq;
+    header->intervalNs = intervalNs;
+    const size_t len = sizeof(LoopCollectorHeader) + sizeof(LoopCollectorRecord) * count;
+    const ssize_t rc = sendto(st.fd, st.buffer.data(), len, MSG_DONTWAIT | MSG_NOSIGNAL,
+                              reinterpret_cast<const sockaddr*>(&st.addr), sizeof(st.addr));
+    if (rc < 0) {
+        st.droppedBatches.fetch_add(1, std::memory_order_relaxed);   // EAGAIN/ECONNREFUSED/ENOENT 均丢弃
+    } else {
+        st.sentBatches.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// 汇总本周期有变化的站点（每 kCollectorFullSyncPeriods 个周期发全部站点）；
+// 通常一个数据报即可装下，即每周期恰好一次系统调用
+inline void flushCollectorLocked(LoopCollectorClientState& st) {
+    if (st.fd < 0) return;
+    const uint64_t nowNs = monotonicNs();
+    const uint64_t intervalNs = st.lastSendNs ? nowNs - st.lastSendNs : 0;
+    st.lastSendNs = nowNs;
+    const bool fullSync = st.flushCount++ % kCollectorFullSyncPeriods == 0;
+    auto* records = reinterpret_cast<LoopCollectorRecord*>(st.buffer.data() + sizeof(LoopCollectorHeader));
+    uint32_t count = 0;
+    bool sent = false;
+    forEachLoopSite([&](const LoopSite& site) {
+        if (site.id > st.prev.size()) st.prev.resize(site.id);
+        LoopSiteSnapshot& old = st.prev[site.id - 1];
+        const LoopSiteSnapshot cur = snapshotLoopSite(site);
+        const bool changed = cur.invocations != old.invocations || cur.violations != old.violations;
+        if (!changed && !(fullSync && (cur.invocations || cur.violations))) return;
+        LoopCollectorRecord& rec = records[count];
+        rec.nameHash = site.nameHash;
+        std::memset(rec.name, 0, kCollectorNameLen);
+        std::strncpy(rec.name, site.name, kCollectorNameLen - 1);
+        rec.invocations = cur.invocations;
+        rec.iterations = cur.iterations;
+        rec.violations = cur.violations;
+        rec.timedInvocations = cur.timedInvocations;
+        rec.totalNs = cur.totalNs;
+        rec.maxN = cur.maxN;
+        old = cur;
+        if (++count == kCollectorBatchSites) {
+            sendCollectorBatch(st, count, intervalNs);
+            count = 0;
+            sent = true;
+        }
+    });
+    // 无变化的周期也发一个空批，汇总进程据此判断进程仍存活
+    if (count || !sent) sendCollectorBatch(st, count, intervalNs);
+}
+
+// 停止上报线程（线程退出前补发最后一批）并关闭套接字（stopLoopCollectorClient 与进程退出共用）
+inline void stopLoopCollectorThread(LoopCollectorClientState& st) {
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (!st.running.load()) return;
+        st.running.store(false);
+        t = std::move(st.thread);
+    }
+    st.wakeup.notify_all();
+    if (t.joinable()) t.join();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    ::close(st.fd);
+    st.fd = -1;
+}
+
+// 从 main 返回时仍在上报则在此汇合，否则 std::thread 析构会 terminate
+inline LoopCollectorClientState::~LoopCollectorClientState() {
+    stopLoopCollectorThread(*this);
+}
+
+} // namespace LoopMonitor
+
+/**
+ * 15. 上报到主机级汇总进程（tools/LoopCollector.cpp）
+ * 用法：startLoopCollectorClient(); // 每秒把有变化站点的累计值打包发往 /tmp/loopmon-collector.sock
+ * 说明：每周期一次非阻塞 sendto（站点超过 64 个时按 64 个一批拆分），与告警次数无关；
+ *       汇总进程未启动或缓冲区满时丢弃本批，不重试、不阻塞（发送的是累计值，丢弃的增量随下一批补上）；
+ *       套接字由汇总进程以 0660 创建，上报进程需与其同组
+ */
+inline bool startLoopCollectorClient(const std::string& socketPath = LoopMonitor::kDefaultCollectorSocket,
+                                     uint64_t intervalMs = 1000) {
+    auto& st = LoopMonitor::LOOP_COLLECTOR_CLIENT;
+    std::lock_guard<std::mutex> lock(st.mutex);
+    if (st.running.load()) return true;
+    if (socketPath.size() >= sizeof(st.addr.sun_path)) {
+        LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Collector, LoopMonitor::LoopEventLevel::Error)
+            << "[LOOP_COLLECTOR] 套接字路径过长: " << socketPath;
+        return false;
+    }
+    st.fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (st.fd < 0) {
+        LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Collector, LoopMonitor::LoopEventLevel::Error)
+            << "[LOOP_COLLECTOR] 创建套接字失败: " << std::strerror(errno);
+        return false;
+    }
+    st.addr = {};
+    st.addr.sun_family = AF_UNIX;
+    std::strncpy(st.addr.sun_path, socketPath.c_str(), sizeof(st.addr.sun_path) - 1);
+    st.buffer.assign(sizeof(LoopMonitor::LoopCollectorHeader) +
+                     sizeof(LoopMonitor::LoopCollectorRecord) * LoopMonitor::kCollectorBatchSites, 0);
+    st.lastSendNs = LoopMonitor::monotonicNs();
+
+    LoopMonitorConfig::COLLECTOR_INTERVAL_MS.store(intervalMs);
+    st.running.store(true);
+    st.thread = std::thread([] {
+        auto& s = LoopMonitor::LOOP_COLLECTOR_CLIENT;
+        std::unique_lock<std::mutex> lk(s.mutex);
+        while (s.running.load()) {
+            s.wakeup.wait_for(lk, std::chrono::milliseconds(LoopMonitorConfig::COLLECTOR_INTERVAL_MS.load()));
+            LoopMonitor::flushCollectorLocked(s);
+        }
+    });
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config) << "[LOOP_CONFIG] 汇总上报已启动: " << socketPath;
+    return true;
+}
+
+/**
+ * 16. 停止上报（退出前补发最后一批增量）
+ * 用法：stopLoopCollectorClient();
+ * 说明：未调用时进程退出（main 返回或 exit）会自动停止
+ */
+inline void stopLoopCollectorClient() {
+    LoopMonitor::stopLoopCollectorThread(LoopMonitor::LOOP_COLLECTOR_CLIENT);
+}
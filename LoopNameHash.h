@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 站点名哈希：编译期把字符串字面量折叠成 64 位 FNV-1a，站点身份/按名配置/去重都用整数比较；
+// 名字本身只留作输出（见 LoopSite::name 与 findLoopSiteByHash）
+namespace LoopMonitor {
+
+inline constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+inline constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+
+// 运行时也可调用（按名设置采样率、加载基线等冷路径）
+constexpr uint64_t loopNameHash(std::string_view name) {
+    uint64_t h = kFnvOffsetBasis;
+    for (char c : name) {
+        h ^= static_cast<uint8_t>(c);
+        h *= kFnvPrime;
+    }
+    return h;
+}
+
+// 可作模板实参的字符串字面量
+template <size_t N>
+struct FixedString {
+    char data[N] {};
+
+    consteval FixedString(const char (&str)[N]) {
+        for (size_t i = 0; i < N; ++i) data[i] = str[i];
+    }
+
+    constexpr std::string_view view() const { return {data, N - 1}; }
+};
+
+template <FixedString Name>
+inline constexpr uint64_t kLoopNameHash = [] {
+    constexpr uint64_t h = loopNameHash(Name.view());
+    return h;
+}();
+
+} // namespace LoopMonitor
@@ -0,0 +1,114 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// NUMA 分片：站点统计按线程所在节点分片写入，跨插槽的线程不再争抢同一缓存行；
+// 其他节点的分片在站点登记时从各节点本地的内存块预先分配（热路径只读指针，不加锁、不分配），只在读取快照时汇总
+namespace LoopMonitorConfig {
+    // 是否按 NUMA 节点分片（单节点机器上无效；对之后登记的站点生效，之前登记的站点仍写节点 0 的统计）
+    inline std::atomic<bool> ENABLE_NUMA_SHARDING = true;
+}
+
+namespace LoopMonitor {
+
+inline constexpr uint32_t kMaxLoopNodes = 8;
+// 节点本地内存块大小（分片从中顺序切分，进程内不释放）
+inline constexpr size_t kLoopNodeArenaChunk = 1 << 20;
+
+// 在线节点数：/sys/devices/system/node/online 中的最大编号 + 1（如 "0-1"），读不到时为 1
+inline uint32_t detectLoopNumaNodes() {
+    FILE* f = std::fopen("/sys/devices/system/node/online", "r");
+    if (!f) return 1;
+    uint32_t maxNode = 0;
+    uint32_t value = 0;
+    bool inNumber = false;
+    for (int c = std::fgetc(f); ; c = std::fgetc(f)) {
+        if (c >= '0' && c <= '9') {
+            value = value * 10 + static_cast<uint32_t>(c - '0');
+            inNumber = true;
+            continue;
+        }
+        if (inNumber) maxNode = std::max(maxNode, value);
+        value = 0;
+        inNumber = false;
+        if (c == EOF) break;
+    }
+    std::fclose(f);
+    return std::min(maxNode + 1, kMaxLoopNodes);
+}
+
+inline uint32_t loopNumaNodes() {
+    static const uint32_t nodes = detectLoopNumaNodes();
+    return nodes;
+}
+
+// 线程所在节点（首次写统计时取一次；线程之后迁移到其他节点时计数仍正确，只是不再本地）
+inline thread_local uint32_t LOOP_THREAD_NODE = UINT32_MAX;
+
+[[gnu::cold]] [[gnu::noinline]] inline uint32_t detectLoopThreadNode() {
+    uint32_t node = 0;
+    if (loopNumaNodes() > 1 && LoopMonitorConfig::ENABLE_NUMA_SHARDING.load(std::memory_order_relaxed)) {
+        unsigned cpu = 0;
+        unsigned n = 0;
+        if (syscall(SYS_getcpu, &cpu, &n, nullptr) == 0 && n < loopNumaNodes()) node = n;
+    }
+    LOOP_THREAD_NODE = node;
+    return node;
+}
+
+inline uint32_t currentLoopNode() {
+    const uint32_t node = LOOP_THREAD_NODE;
+    return node != UINT32_MAX ? node : detectLoopThreadNode();
+}
+
+struct LoopNodeArena {
+    std::mutex mutex;
+    char* cursor = nullptr;
+    size_t left = 0;
+};
+
+inline LoopNodeArena LOOP_NODE_ARENAS[kMaxLoopNodes];
+
+// 从节点本地内存块切出 size 字节（64 字节对齐，已清零）；调用方持有 arena.mutex
+inline void* allocLoopNodeMemoryLocked(LoopNodeArena& arena, uint32_t node, size_t size) {
+    size = (size + 63) & ~size_t{63};
+    if (arena.left < size) {
+        const size_t chunk = std::max(size, kLoopNodeArenaChunk);
+        void* p = mmap(nullptr, chunk, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return nullptr;
+        // 首选本节点；mbind 不可用（容器内常见）时退回首次访问原则，分配方本就运行在该节点上
+        constexpr int kMpolPreferred = 1;
+        unsigned long mask = 1ul << node;
+        syscall(SYS_mbind, p, chunk, kMpolPreferred, &mask, sizeof(mask) * 8, 0);
+        arena.cursor = static_cast<char*>(p);
+        arena.left = chunk;
+    }
+    void* out = arena.cursor;
+    arena.cursor += size;
+    arena.left -= size;
+    return out;
+}
+
+// 取 slot 中的节点分片，为空时在节点本地内存上构造（每个 slot 只构造一次；内存不足时返回 nullptr）
+// 加锁并可能 mmap，只在站点登记时调用
+template <typename T>
+[[gnu::cold]] [[gnu::noinline]] T* createOnLoopNode(uint32_t node, std::atomic<T*>& slot) {
+    LoopNodeArena& arena = LOOP_NODE_ARENAS[node];
+    std::lock_guard<std::mutex> lock(arena.mutex);
+    if (T* existing = slot.load(std::memory_order_acquire)) return existing;
+    void* mem = allocLoopNodeMemoryLocked(arena, node, sizeof(T));
+    if (!mem) return nullptr;
+    T* created = new (mem) T();
+    slot.store(created, std::memory_order_release);
+    return created;
+}
+
+} // namespace LoopMonitor
@@ -0,0 +1,177 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 硬件性能计数（按线程打开 perf_event，rdpmc 用户态直读）
+namespace LoopMonitorConfig {
+    // 是否为守卫采集性能计数（默认关闭，排查计算型/缓存型瓶颈时打开）
+    inline std::atomic<bool> ENABLE_PERF_COUNTERS = false;
+}
+
+namespace LoopMonitor {
+
+// 计数来源：硬件 PMU 不可用（容器/虚拟机）时退化为软件计数
+enum class PerfSource : uint8_t { Hardware, Software };
+
+struct PerfSample {
+    uint64_t instructions = 0;
+    uint64_t cycles = 0;
+    uint64_t llcMisses = 0;
+    uint64_t branchMisses = 0;
+    uint64_t cpuNs = 0;   // 线程 CPU 时间（软件模式）
+
+    PerfSample operator-(const PerfSample& o) const {
+        return {instructions - o.instructions, cycles - o.cycles,
+                llcMisses - o.llcMisses, branchMisses - o.branchMisses, cpuNs - o.cpuNs};
+    }
+};
+
+inline const char* perfSourceName(PerfSource source) {
+    return source == PerfSource::Hardware ? "hw" : "sw";
+}
+
+// 计数项位掩码（与 PerfSample 字段一一对应）；硬件组员可能单独打不开，软件模式只采线程 CPU 时间
+enum PerfCounterBit : uint32_t {
+    kPerfInstructions = 1u << 0,
+    kPerfCycles = 1u << 1,
+    kPerfLlcMisses = 1u << 2,
+    kPerfBranchMisses = 1u << 3,
+    kPerfCpuTime = 1u << 4,
+};
+inline constexpr uint32_t kPerfHardwareCounters = kPerfInstructions | kPerfCycles | kPerfLlcMisses | kPerfBranchMisses;
+inline constexpr uint32_t kPerfAllCounters = kPerfHardwareCounters | kPerfCpuTime;
+inline constexpr const char* kPerfCounterNames[] = {"Instructions", "Cycles", "LLC-Misses", "Branch-Misses", "CPU(ns)"};
+
+// 进程内各线程采到的计数项（按位或）与缺失的计数项：汇总统计里只输出所有线程都采到的项，
+// 缺失项读数恒为 0，混进报告会被误读为"没有缓存缺失"
+inline std::atomic<uint32_t> LOOP_PERF_RECORDED{0};
+inline std::atomic<uint32_t> LOOP_PERF_MISSING{0};
+
+inline uint32_t loopPerfReportMask() {
+    return LOOP_PERF_RECORDED.load(std::memory_order_relaxed) & ~LOOP_PERF_MISSING.load(std::memory_order_relaxed);
+}
+
+// 线程计数组打开后登记本线程采到的项；新出现的不可用硬件事件打一次日志（DynamicLoopCheck.cpp）
+[[gnu::cold]] [[gnu::noinline]] void notePerfCounterMask(uint32_t valid);
+
+// 单线程计数组：首次使用时打开，线程退出时关闭
+class ThreadPerfCounters {
+public:
+    static ThreadPerfCounters& local() {
+        thread_local ThreadPerfCounters counters;
+        return counters;
+    }
+
+    PerfSource source() const { return source_; }
+    uint32_t validMask() const { return valid_; }
+
+    PerfSample read() {
+        PerfSample s;
+        if (source_ == PerfSource::Hardware) {
+            s.instructions = readEvent(events_[0]);
+            s.cycles = readEvent(events_[1]);
+            s.llcMisses = readEvent(events_[2]);
+            s.branchMisses = readEvent(events_[3]);
+        } else {
+            timespec ts{};
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            s.cpuNs = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull +
+                      static_cast<uint64_t>(ts.tv_nsec);
+        }
+        return s;
+    }
+
+    ThreadPerfCounters(const ThreadPerfCounters&) = delete;
+    ThreadPerfCounters& operator=(const ThreadPerfCounters&) = delete;
+
+private:
+    struct Event {
+        int fd = -1;
+        perf_event_mmap_page* page = nullptr;
+    };
+
+    ThreadPerfCounters() {
+        static constexpr uint64_t kConfigs[4] = {
+            PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int i = 0; i < 4; ++i) {
+            events_[i].fd = openEvent(kConfigs[i], i == 0 ? -1 : events_[0].fd);
+            if (events_[i].fd < 0) continue;
+            void* p = mmap(nullptr, static_cast<size_t>(sysconf(_SC_PAGESIZE)),
+                           PROT_READ, MAP_SHARED, events_[i].fd, 0);
+            if (p != MAP_FAILED) events_[i].page = static_cast<perf_event_mmap_page*>(p);
+        }
+        // 组长（指令数）都打不开，说明 PMU 不可用，整体退化为线程 CPU 时间；
+        // 组员单独打不开（事件不受支持或计数器不够）时只缺这一项，读数为 0，记入掩码不参与报告
+        if (events_[0].fd >= 0) {
+            source_ = PerfSource::Hardware;
+            for (int i = 0; i < 4; ++i) {
+                if (events_[i].fd >= 0) valid_ |= 1u << i;
+            }
+        } else {
+            source_ = PerfSource::Software;
+            valid_ = kPerfCpuTime;
+        }
+        notePerfCounterMask(valid_);
+    }
+
+    ~ThreadPerfCounters() {
+        for (auto& e : events_) {
+            if (e.page) munmap(e.page, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+            if (e.fd >= 0) close(e.fd);
+        }
+    }
+
+    static int openEvent(uint64_t config, int groupFd) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+    }
+
+    static uint64_t readEvent(const Event& e) {
+        if (e.fd < 0) return 0;
+#if defined(__x86_64__) || defined(__i386__)
+        // rdpmc 快路径：按 perf_event_mmap_page 的 seqlock 协议读取
+        if (e.page && e.page->cap_user_rdpmc) {
+            volatile perf_event_mmap_page* pg = e.page;
+            uint32_t seq, idx;
+            uint64_t count;
+            do {
+                seq = pg->lock;
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+                idx = pg->index;
+                count = static_cast<uint64_t>(pg->offset);
+                if (idx == 0) break;   // 事件当前未上 PMU，走 read()
+                uint32_t lo, hi;
+                __asm__ volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(idx - 1));
+                const unsigned shift = 64u - pg->pmc_width;
+                int64_t pmc = static_cast<int64_t>((static_cast<uint64_t>(hi) << 32) | lo);
+                pmc = static_cast<int64_t>(static_cast<uint64_t>(pmc) << shift) >> shift;
+                count += static_cast<uint64_t>(pmc);
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+            } while (pg->lock != seq);
+            if (idx != 0) return count;
+        }
+#endif
+        uint64_t value = 0;
+        if (::read(e.fd, &value, sizeof(value)) != static_cast<ssize_t>(sizeof(value))) return 0;
+        return value;
+    }
+
+    Event events_[4];
+    PerfSource source_ = PerfSource::Software;
+    uint32_t valid_ = 0;   // 本线程实际采集的计数项（PerfCounterBit）
+};
+
+} // namespace LoopMonitor
@@ -0,0 +1,331 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+#include "LoopSite.h"
+#include "LoopSink.h"
+#include "LoopAdaptiveThreshold.h"
+
+// 跨重启的持久状态：站点表、学习到的阈值、告警抑制状态与累计统计放在文件映射（MAP_SHARED）里，
+// 后台线程定期写回；进程崩溃后内容仍在页缓存中。重启时只映射文件、读头部，
+// 站点首次登记时按名字哈希 O(1) 取回自己的状态，启动耗时与站点数无关
+// 只取回学习到的状态：采样率等用户配置以本次启动的设置为准；
+// 重启前的累计统计只在快照里续加，不并入站点统计（dump、共享内存导出与汇总上报只含本进程，汇总方按 pid 求差不会重复计入）
+// 全局状态与每条站点记录都是双槽：先写非活动槽再切换活动下标，任何时刻崩溃都留下完整的旧槽或新槽
+namespace LoopMonitorConfig {
+    // 写回周期（毫秒）
+    inline std::atomic<uint64_t> PERSIST_INTERVAL_MS = 1000;
+}
+
+// 定义见 DynamicLoopCheck.cpp
+namespace LoopMonitorConfig {
+    extern std::atomic<uint64_t> LOOP_WARN_THRESHOLD;
+    extern std::atomic<bool> WARN_ONCE_PER_PROCESS;
+}
+
+namespace LoopMonitor {
+
+inline constexpr uint64_t kLoopPersistMagic = 0x314554415453504CULL;   // "LPSTATE1"
+inline constexpr uint32_t kLoopPersistVersion = 2;
+// 开放寻址表容量（负载不超过 0.5）
+inline constexpr uint32_t kLoopPersistCapacity = kMaxLoopSites * 2;
+inline constexpr size_t kLoopPersistNameLen = 64;
+
+struct LoopPersistGlobalSlot {
+    uint64_t checkpointSeq;
+    uint64_t warnThreshold;        // setLoopWarnThreshold 设置的全局阈值
+    uint8_t warnOncePending;       // 告警开关（WARN_ONCE_PER_PROCESS）
+};
+
+struct alignas(64) LoopPersistHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t capacity;
+    uint64_t createdNs;
+    std::atomic<uint64_t> checkpointSeq;   // 已完成的写回轮数
+    std::atomic<uint32_t> activeGlobal;
+    LoopPersistGlobalSlot global[2];
+};
+
+struct LoopPersistSiteSlot {
+    uint64_t checkpointSeq;
+    uint64_t threshold;
+    uint32_t reserved;             // 原采样率（用户配置，不再持久化；保留布局）
+    uint8_t adaptiveState;
+    uint8_t allocAlerted;
+    uint8_t warned;                // 当前告警轮次已告警（占用原填充字节，布局不变）
+    uint64_t nsPerIterQ16;         // 学习到的每次迭代耗时（v2）
+    uint64_t invocations;
+    uint64_t samples;
+    uint64_t iterations;
+    uint64_t maxN;
+    uint64_t violations;
+    uint64_t timedInvocations;
+    uint64_t totalNs;
+};
+
+struct alignas(64) LoopPersistRecord {
+    std::atomic<uint64_t> nameHash;        // 0 表示空槽；名字写完后才发布
+    char name[kLoopPersistNameLen];
+    std::atomic<uint32_t> active;
+    LoopPersistSiteSlot slots[2];
+};
+
+inline size_t loopPersistFileSize(uint32_t capacity) {
+    return sizeof(LoopPersistHeader) + sizeof(LoopPersistRecord) * capacity;
+}
+
+// 重启前的累计统计（取回时记下，写回时与本进程的统计相加）
+struct LoopPersistTotals {
+    uint64_t invocations = 0;
+    uint64_t samples = 0;
+    uint64_t iterations = 0;
+    uint64_t maxN = 0;
+    uint64_t violations = 0;
+    uint64_t timedInvocations = 0;
+    uint64_t totalNs = 0;
+};
+
+struct LoopPersistState {
+    LoopPersistHeader* header = nullptr;
+    LoopPersistRecord* records = nullptr;
+    size_t size = 0;
+    int fd = -1;
+    std::string path;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::unordered_map<uint64_t, LoopPersistTotals> restoredTotals;   // 按站点名哈希，持 mutex 访问
+    ~LoopPersistState();
+};
+
+inline LoopPersistState LOOP_PERSIST;
+
+// 线性探测；insert 为 true 时在首个空槽登记（只有持锁的写回方插入）
+inline LoopPersistRecord* findLoopPersistRecord(LoopPersistState& st, const LoopSite& site, bool insert) {
+    const uint32_t mask = st.header->capacity - 1;
+    uint32_t idx = static_cast<uint32_t>(site.nameHash) & mask;
+    for (uint32_t probe = 0; probe <= mask; ++probe, idx = (idx + 1) & mask) {
+        LoopPersistRecord& rec = st.records[idx];
+        const uint64_t h = rec.nameHash.load(std::memory_order_acquire);
+        if (h == site.nameHash) return &rec;
+        if (h != 0) continue;
+        if (!insert) return nullptr;
+        std::memset(rec.name, 0, kLoopPersistNameLen);
+        std::strncpy(rec.name, site.name, kLoopPersistNameLen - 1);
+        rec.nameHash.store(site.nameHash, std::memory_order_release);
+        return &rec;
+    }
+    return nullptr;
+}
+
+// LOOP_SITE_RESTORE 钩子：把快照里的状态合并进刚登记的站点（每站点一次）
+inline void restoreLoopSiteState(LoopSite& site) {
+    auto& st = LOOP_PERSIST;
+    std::lock_guard<std::mutex> lock(st.mutex);
+    if (!st.header || site.persistRestored.exchange(true)) return;
+    const LoopPersistRecord* rec = findLoopPersistRecord(st, site, false);
+    if (!rec) return;
+    const LoopPersistSiteSlot& s = rec->slots[rec->active.load(std::memory_order_acquire) & 1];
+    constexpr auto r = std::memory_order_relaxed;
+    // 只续用学习到的阈值；剖析预置每次启动按当前剖析文件重新计算
+    if (s.adaptiveState == kAdaptiveLearned && s.threshold) {
+        site.threshold.store(s.threshold, r);
+        site.adaptiveState.store(kAdaptiveLearned, r);
+    }
+    // 单次迭代耗时只补未学习、未显式设置的站点（启动持久化前登记的站点可能已有本进程的值）
+    uint64_t unset = 0;
+    if (s.nsPerIterQ16) site.nsPerIterQ16.compare_exchange_strong(unset, s.nsPerIterQ16, r);
+    if (s.allocAlerted) site.allocAlerted.store(true, r);
+    if (s.warned) site.warnedEpoch.store(LOOP_WARN_EPOCH.load(r), r);
+    st.restoredTotals[site.nameHash] = {s.invocations, s.samples, s.iterations, s.maxN,
+                                        s.violations, s.timedInvocations, s.totalNs};
+}
+
+// 写回一轮：每条记录写非活动槽再切换，切换前崩溃则旧槽仍完整
+inline void checkpointLoopStateLocked(LoopPersistState& st) {
+    if (!st.header) return;
+    const uint64_t seq = st.header->checkpointSeq.load(std::memory_order_relaxed) + 1;
+    forEachLoopSite([&](const LoopSite& site) {
+        if (!site.persistRestored.load(std::memory_order_acquire)) return;
+        LoopPersistRecord* rec = findLoopPersistRecord(st, site, true);
+        if (!rec) return;   // 表满：该站点不持久化
+        const uint32_t next = (rec->active.load(std::memory_order_relaxed) & 1) ^ 1;
+        LoopPersistSiteSlot& s = rec->slots[next];
+        const LoopSiteSnapshot snap = snapshotLoopSite(site);
+        LoopPersistTotals prev;
+        if (auto it = st.restoredTotals.find(site.nameHash); it != st.restoredTotals.end()) prev = it->second;
+        constexpr auto r = std::memory_order_relaxed;
+        s.checkpointSeq = seq;
+        s.threshold = site.threshold.load(r);
+        s.reserved = 0;
+        s.adaptiveState = site.adaptiveState.load(r);
+        s.allocAlerted = site.allocAlerted.load(r) ? 1 : 0;
+        s.warned = site.warnedEpoch.load(r) == LOOP_WARN_EPOCH.load(r) ? 1 : 0;
+        s.nsPerIterQ16 = site.nsPerIterQ16.load(r);
+        s.invocations = prev.invocations + snap.invocations;
+        s.samples = prev.samples + snap.samples;
+        s.iterations = prev.iterations + snap.iterations;
+        s.maxN = std::max(prev.maxN, snap.maxN);
+        s.violations = prev.violations + snap.violations;
+        s.timedInvocations = prev.timedInvocations + snap.timedInvocations;
+        s.totalNs = prev.totalNs + snap.totalNs;
+        rec->active.store(next, std::memory_order_release);
+    });
+    const uint32_t next = (st.header->activeGlobal.load(std::memory_order_relaxed) & 1) ^ 1;
+    LoopPersistGlobalSlot& g = st.header->global[next];
+    g.checkpointSeq = seq;
+    g.warnThreshold = LoopMonitorConfig::LOOP_WARN_THRESHOLD.load(std::memory_order_relaxed);
+    g.warnOncePending = LoopMonitorConfig::WARN_ONCE_PER_PROCESS.load(std::memory_order_relaxed) ? 1 : 0;
+    st.header->activeGlobal.store(next, std::memory_order_release);
+    st.header->checkpointSeq.store(seq, std::memory_order_release);
+}
+
+// 校验已有快照的布局；不符（含首次创建）时清空重建，magic 最后写
+inline bool prepareLoopPersistFile(LoopPersistState& st, bool& reused) {
+    struct stat sb {};
+    if (fstat(st.fd, &sb) != 0) return false;
+    reused = false;
+    if (static_cast<size_t>(sb.st_size) == st.size) {
+        void* p = mmap(nullptr, st.size, PROT_READ | PROT_WRITE, MAP_SHARED, st.fd, 0);
+        if (p == MAP_FAILED) return false;
+        auto* header = static_cast<LoopPersistHeader*>(p);
+        if (header->magic == kLoopPersistMagic && header->version == kLoopPersistVersion &&
+            header->headerSize == sizeof(LoopPersistHeader) && header->recordSize == sizeof(LoopPersistRecord) &&
+            header->capacity == kLoopPersistCapacity) {
+            st.header = header;
+            reused = true;
+            return true;
+        }
+        munmap(p, st.size);
+    }
+    // 稀疏文件：只有写过的记录占用磁盘
+    if (ftruncate(st.fd, 0) != 0 || ftruncate(st.fd, static_cast<off_t>(st.size)) != 0) return false;
+    void* p = mmap(nullptr, st.size, PROT_READ | PROT_WRITE, MAP_SHARED, st.fd, 0);
+    if (p == MAP_FAILED) return false;
+    st.header = static_cast<LoopPersistHeader*>(p);
+    st.header->version = kLoopPersistVersion;
+    st.header->headerSize = sizeof(LoopPersistHeader);
+    st.header->recordSize = sizeof(LoopPersistRecord);
+    st.header->capacity = kLoopPersistCapacity;
+    st.header->createdNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    std::atomic_thread_fence(std::memory_order_release);
+    st.header->magic = kLoopPersistMagic;
+    return true;
+}
+
+// 停止写回线程，写回最后一轮并落盘（stopLoopStatePersistence 与进程退出共用）
+inline void stopLoopPersistThread(LoopPersistState& st) {
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (!st.running.load()) return;
+        st.running.store(false);
+        t = std::move(st.thread);
+    }
+    st.wakeup.notify_all();
+    if (t.joinable()) t.join();
+    LOOP_SITE_RESTORE.store(nullptr);
+    std::lock_guard<std::mutex> lock(st.mutex);
+    checkpointLoopStateLocked(st);
+    msync(st.header, st.size, MS_SYNC);
+    munmap(st.header, st.size);
+    ::close(st.fd);
+    st.fd = -1;
+    st.header = nullptr;
+    st.records = nullptr;
+    st.restoredTotals.clear();
+}
+
+// 从 main 返回时仍在持久化则在此汇合并写回最后一轮（站点对象无析构，退出时仍可读）
+inline LoopPersistState::~LoopPersistState() {
+    stopLoopPersistThread(*this);
+}
+
+} // namespace LoopMonitor
+
+/**
+ * 27. 跨重启保留监控状态（文件映射快照）
+ * 用法：startLoopStatePersistence("/var/lib/app/loop.state"); // 进程启动时调用，每秒写回一次
+ * 说明：保留全局阈值、同进程仅一次告警的抑制状态，以及各站点学习到的阈值、单次迭代耗时、分配告警标记和累计统计；
+ *       采样率等用户配置不取回，以本次启动的设置为准；累计统计只在快照里跨重启续加，进程内统计从 0 开始；
+ *       启动只做一次 open + mmap + 头部校验，站点在首次登记时 O(1) 取回；
+ *       布局版本不符时清空重建；同一文件同时只允许一个进程使用（flock）
+ */
+inline bool startLoopStatePersistence(const std::string& path, uint64_t intervalMs = 1000) {
+    auto& st = LoopMonitor::LOOP_PERSIST;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (st.running.load() || st.header) return true;
+        st.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (st.fd < 0 || flock(st.fd, LOCK_EX | LOCK_NB) != 0) {
+            if (st.fd >= 0) ::close(st.fd);
+            st.fd = -1;
+            LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config, LoopMonitor::LoopEventLevel::Error)
+                << "[LOOP_PERSIST] 无法打开或已被其他进程占用: " << path;
+            return false;
+        }
+        st.path = path;
+        st.size = LoopMonitor::loopPersistFileSize(LoopMonitor::kLoopPersistCapacity);
+        bool reused = false;
+        if (!LoopMonitor::prepareLoopPersistFile(st, reused)) {
+            ::close(st.fd);
+            st.fd = -1;
+            st.header = nullptr;
+            LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config, LoopMonitor::LoopEventLevel::Error)
+                << "[LOOP_PERSIST] 映射快照文件失败: " << path;
+            return false;
+        }
+        st.records = reinterpret_cast<LoopMonitor::LoopPersistRecord*>(
+            reinterpret_cast<char*>(st.header) + sizeof(LoopMonitor::LoopPersistHeader));
+        const uint64_t seq = st.header->checkpointSeq.load(std::memory_order_acquire);
+        if (reused && seq) {
+            const auto& g = st.header->global[st.header->activeGlobal.load(std::memory_order_acquire) & 1];
+            LoopMonitorConfig::LOOP_WARN_THRESHOLD.store(g.warnThreshold);
+            LoopMonitorConfig::WARN_ONCE_PER_PROCESS.store(g.warnOncePending != 0);
+        }
+        LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config)
+            << "[LOOP_CONFIG] 持久状态: " << path << (reused ? " | 已续用，写回轮数: " : " | 新建，写回轮数: ") << seq;
+    }
+    // 先装钩子再补取已登记的站点：与并发登记的站点至少一方能看到对方（重复取回由站点标记去重）
+    LoopMonitor::LOOP_SITE_RESTORE.store(&LoopMonitor::restoreLoopSiteState, std::memory_order_seq_cst);
+    LoopMonitor::forEachLoopSite([](LoopMonitor::LoopSite& site) { LoopMonitor::restoreLoopSiteState(site); });
+
+    LoopMonitorConfig::PERSIST_INTERVAL_MS.store(intervalMs);
+    std::lock_guard<std::mutex> lock(st.mutex);
+    st.running.store(true);
+    st.thread = std::thread([] {
+        auto& s = LoopMonitor::LOOP_PERSIST;
+        std::unique_lock<std::mutex> lk(s.mutex);
+        while (s.running.load()) {
+            s.wakeup.wait_for(lk, std::chrono::milliseconds(LoopMonitorConfig::PERSIST_INTERVAL_MS.load()));
+            LoopMonitor::checkpointLoopStateLocked(s);
+        }
+    });
+    return true;
+}
+
+/**
+ * 28. 停止持久化（写回最后一轮并落盘）
+ * 用法：stopLoopStatePersistence();
+ * 说明：未调用时进程正常退出（main 返回或 exit）会自动停止并写回
+ */
+inline void stopLoopStatePersistence() {
+    LoopMonitor::stopLoopPersistThread(LoopMonitor::LOOP_PERSIST);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// USDT 探针（provider: loopmon）：无人附加时每个探针只是一条 NOP，bpftrace/perf 附加时才触发，
+// 生产环境不必重新部署即可观察循环规模与超标。需要 <sys/sdt.h>（systemtap-sdt-dev / systemtap-sdt-devel），
+// 没有该头文件或以 -DLOOP_MONITOR_USDT=0 编译时探针为空；示例脚本见 tools/bpftrace/
+//
+//   loopmon:loop_enter     (siteId, N, threshold, name)   每次校验（所有宏与守卫），N 超标之前触发
+//   loopmon:loop_exit      (siteId, N, violated, name)    LOOP_MONITOR_GUARD 离开作用域
+//   loopmon:loop_violation (siteId, N, threshold, name)   N 超标或预计超时（threshold 为预算内可执行的迭代数）
+//   loopmon:loop_clamp     (siteId, N, cap, name)         截断模式下 N 超过站点上限，只执行前 cap 项
+//   loopmon:loop_warn      (name, N, threshold)           loopWarn 被调用（每个站点每轮告警一次，见 claimLoopWarn）
+//
+// name 为站点名（const char*，bpftrace 中用 str(argN) 读取）；enter/exit 在插桩代码所在的二进制里，
+// violation/warn 在 loopmonitor 库里（动态链接时附加到 libloopmonitor.so）
+#ifndef LOOP_MONITOR_USDT
+#if __has_include(<sys/sdt.h>)
+#define LOOP_MONITOR_USDT 1
+#else
+#define LOOP_MONITOR_USDT 0
+#endif
+#endif
+
+#if LOOP_MONITOR_USDT
+#include <sys/sdt.h>
+#define LOOP_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(loopmon, name, a1, a2, a3)
+#define LOOP_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(loopmon, name, a1, a2, a3, a4)
+#else
+#define LOOP_PROBE3(name, a1, a2, a3) ((void)0)
+#define LOOP_PROBE4(name, a1, a2, a3, a4) ((void)0)
+#endif
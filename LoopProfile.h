@@ -0,0 +1,224 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "LoopSite.h"
+#include "LoopSink.h"
+#include "LoopAdaptiveThreshold.h"
+
+// 剖析驱动的阈值预置：录制时把各站点 N 的分布摘要写成定长二进制记录（按名字哈希升序），
+// 新进程启动时只读映射整个文件，站点登记时二分查找，取 录制最大 N × 裕量 作为站点阈值；不做文本解析
+namespace LoopMonitorConfig {
+    // 预置阈值 = 录制到的最大 N × 裕量
+    inline std::atomic<double> PROFILE_THRESHOLD_MARGIN = 2.0;
+}
+
+namespace LoopMonitor {
+
+inline constexpr uint64_t kLoopProfileMagic = 0x31465250504F4F4CULL;   // "LOOPPRF1"
+inline constexpr uint32_t kLoopProfileVersion = 1;
+
+struct LoopProfileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t count;
+    uint64_t createdNs;       // 录制时间（墙钟）
+};
+
+// 每站点一条（48 字节），分位数为直方图桶上界
+struct LoopProfileRecord {
+    uint64_t nameHash;
+    uint64_t samples;         // 直方图样本数（已按采样率放大）
+    uint64_t maxN;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+};
+
+struct LoopProfileState {
+    std::mutex mutex;
+    void* map = nullptr;
+    size_t size = 0;
+    const LoopProfileRecord* records = nullptr;
+    uint32_t count = 0;
+    std::string recordPath;   // 录制模式：进程退出时写入的路径
+    bool atexitRegistered = false;
+};
+
+inline LoopProfileState& loopProfileState() {
+    static LoopProfileState state;
+    return state;
+}
+
+inline const LoopProfileRecord* findLoopProfileRecord(const LoopProfileState& st, uint64_t nameHash) {
+    const LoopProfileRecord* end = st.records + st.count;
+    const LoopProfileRecord* it = std::lower_bound(st.records, end, nameHash,
+        [](const LoopProfileRecord& rec, uint64_t h) { return rec.nameHash < h; });
+    return it != end && it->nameHash == nameHash ? it : nullptr;
+}
+
+inline uint64_t loopProfileThreshold(const LoopProfileRecord& rec) {
+    const double limit = std::ceil(static_cast<double>(rec.maxN > 0 ? rec.maxN : 1) *
+                                   LoopMonitorConfig::PROFILE_THRESHOLD_MARGIN.load(std::memory_order_relaxed));
+    return limit >= 1.8e19 ? UINT64_MAX : static_cast<uint64_t>(limit);
+}
+
+// LOOP_THRESHOLD_PRESET 钩子：每个站点登记时调用一次
+inline uint64_t loopProfilePreset(uint64_t nameHash) {
+    auto& st = loopProfileState();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    const LoopProfileRecord* rec = findLoopProfileRecord(st, nameHash);
+    return rec ? loopProfileThreshold(*rec) : 0;
+}
+
+inline void unmapLoopProfileLocked(LoopProfileState& st) {
+    if (st.map) munmap(st.map, st.size);
+    st.map = nullptr;
+    st.size = 0;
+    st.records = nullptr;
+    st.count = 0;
+}
+
+} // namespace LoopMonitor
+
+/**
+ * 24. 写出剖析文件（各站点 N 分布摘要：样本数、最大 N、p50/p99/p999）
+ * 用法：writeLoopProfile("/var/lib/app/loop.profile");
+ * 说明：先写临时文件再 rename，读者不会看到半截文件；未采到样本的站点不写。
+ *       采样站点的最大 N 只来自命中采样的调用，录制期间建议采样率保持为 1
+ */
+inline bool writeLoopProfile(const std::string& path) {
+    std::vector<LoopMonitor::LoopProfileRecord> records;
+    LoopMonitor::forEachLoopSite([&](const LoopMonitor::LoopSite& site) {
+        uint64_t counts[LoopMonitor::LoopSizeHistogram::kBuckets];
+        const uint64_t total = LoopMonitor::snapshotLoopHistogram(site, counts);
+        if (total == 0) return;
+        records.push_back({site.nameHash, total, LoopMonitor::snapshotLoopSite(site).maxN,
+                           LoopMonitor::histogramQuantile(counts, total, 0.5),
+                           LoopMonitor::histogramQuantile(counts, total, 0.99),
+                           LoopMonitor::histogramQuantile(counts, total, 0.999)});
+    });
+    std::sort(records.begin(), records.end(),
+              [](const auto& a, const auto& b) { return a.nameHash < b.nameHash; });
+
+    LoopMonitor::LoopProfileHeader header {};
+    header.magic = LoopMonitor::kLoopProfileMagic;
+    header.version = LoopMonitor::kLoopProfileVersion;
+    header.headerSize = sizeof(LoopMonitor::LoopProfileHeader);
+    header.recordSize = sizeof(LoopMonitor::LoopProfileRecord);
+    header.count = static_cast<uint32_t>(records.size());
+    header.createdNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    const std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1;
+    if (ok && !records.empty()) {
+        ok = std::fwrite(records.data(), sizeof(records[0]), records.size(), f) == records.size();
+    }
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config, LoopMonitor::LoopEventLevel::Error)
+            << "[LOOP_PROFILE] 写入剖析文件失败: " << path;
+        return false;
+    }
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config)
+        << "[LOOP_PROFILE] 已写入剖析文件: " << path << " | 站点数: " << records.size();
+    return true;
+}
+
+/**
+ * 25. 剖析录制模式（进程正常退出时自动写出剖析文件）
+ * 用法：startLoopProfileRecording("/var/lib/app/loop.profile"); // 压测/灰度流量跑完退出即得到剖析
+ */
+inline void startLoopProfileRecording(const std::string& path) {
+    auto& st = LoopMonitor::loopProfileState();
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        st.recordPath = path;
+        if (!st.atexitRegistered) {
+            st.atexitRegistered = true;
+            std::atexit([] {
+                auto& s = LoopMonitor::loopProfileState();
+                std::string target;
+                {
+                    std::lock_guard<std::mutex> l(s.mutex);
+                    target = s.recordPath;
+                }
+                if (!target.empty()) writeLoopProfile(target);
+            });
+        }
+    }
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config) << "[LOOP_CONFIG] 剖析录制已开启，退出时写入: " << path;
+}
+
+/**
+ * 26. 按剖析文件预置站点阈值（启动时调用，新二进制直接带着正确的阈值上线）
+ * 用法：loadLoopProfile("/var/lib/app/loop.profile", 2.0); // 阈值 = 录制最大 N × 2
+ * 说明：文件整体只读映射，加载只校验头部；站点登记时二分查找（O(log 站点数)），校验热路径不变；
+ *       已登记站点立即应用；自适应学习到的阈值优先，关闭自适应后回到剖析预置
+ */
+inline bool loadLoopProfile(const std::string& path, double margin = 2.0) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat sb {};
+    if (fstat(fd, &sb) != 0 || static_cast<size_t>(sb.st_size) < sizeof(LoopMonitor::LoopProfileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    const size_t size = static_cast<size_t>(sb.st_size);
+    void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    const auto* header = static_cast<const LoopMonitor::LoopProfileHeader*>(p);
+    if (header->magic != LoopMonitor::kLoopProfileMagic || header->version != LoopMonitor::kLoopProfileVersion ||
+        header->recordSize != sizeof(LoopMonitor::LoopProfileRecord) ||
+        header->headerSize < sizeof(LoopMonitor::LoopProfileHeader) ||
+        size < header->headerSize + static_cast<size_t>(header->count) * header->recordSize) {
+        munmap(p, size);
+        LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config, LoopMonitor::LoopEventLevel::Error)
+            << "[LOOP_PROFILE] 剖析文件格式不符: " << path;
+        return false;
+    }
+
+    // 发布后映射归全局状态所有，并发的另一次 loadLoopProfile 随时可能解除它：发布前取出所需字段，之后不再读 header
+    const uint32_t count = header->count;
+    const auto* records = reinterpret_cast<const LoopMonitor::LoopProfileRecord*>(
+        static_cast<const char*>(p) + header->headerSize);
+    LoopMonitorConfig::PROFILE_THRESHOLD_MARGIN.store(margin);
+    auto& st = LoopMonitor::loopProfileState();
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        LoopMonitor::unmapLoopProfileLocked(st);
+        st.map = p;
+        st.size = size;
+        st.records = records;
+        st.count = count;
+    }
+    // 先装钩子再遍历：与并发登记的站点至少一方能看到对方
+    LoopMonitor::LOOP_THRESHOLD_PRESET.store(&LoopMonitor::loopProfilePreset, std::memory_order_seq_cst);
+    LoopMonitor::forEachLoopSite([](LoopMonitor::LoopSite& site) {
+        if (site.adaptiveState.load() == LoopMonitor::kAdaptiveLearned) return;
+        if (const uint64_t t = LoopMonitor::loopProfilePreset(site.nameHash)) {
+            site.threshold.store(t, std::memory_order_relaxed);
+        }
+    });
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config)
+        << "[LOOP_CONFIG] 已加载剖析阈值: " << path << " | 站点数: " << count << " | 裕量: " << margin;
+    return true;
+}
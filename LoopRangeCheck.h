@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include "LoopSite.h"
+
+// 容器/范围感知的 N：直接取容器大小（std::array / C 数组同样按 size 取），拒绝负数
+namespace LoopMonitor {
+
+template <typename T>
+concept LoopSizeSource = std::ranges::sized_range<const T&> || std::is_integral_v<T>;
+
+// 负数 N：计数超标，每站点每轮只告警一次（经 claimLoopWarn，与其他超标告警共用认领；定义见 DynamicLoopCheck.cpp）
+[[gnu::cold]] [[gnu::noinline]] void reportNegativeLoopSize(LoopSite& site, int64_t value);
+
+// 取循环规模：容器/范围用 size()，有符号整数拒绝负数（返回 false 表示非法）
+template <typename SiteFn, typename T>
+inline bool loopSizeOf(SiteFn&& siteFn, const T& source, uint64_t& size) {
+    static_assert(LoopSizeSource<T>, "CHECK_LOOP_DYNAMIC_SIZE: N 需为整数或 sized_range 容器");
+    if constexpr (std::ranges::sized_range<const T&>) {
+        size = static_cast<uint64_t>(std::ranges::size(source));
+    } else if constexpr (std::is_signed_v<T>) {
+        if (source < 0) [[unlikely]] {
+            reportNegativeLoopSize(siteFn(), static_cast<int64_t>(source));
+            size = 0;
+            return false;
+        }
+        size = static_cast<uint64_t>(source);
+    } else {
+        size = static_cast<uint64_t>(source);
+    }
+    return true;
+}
+
+// i <= n 的规模 n + 1（loop-instrument 对 <= 上限生成的调用）：无符号最大值饱和、不回绕为 0；
+// 有符号负数原样返回，由 loopSizeOf 按负数告警
+template <typename T>
+    requires std::is_integral_v<T>
+constexpr auto inclusiveBound(T n) {
+    if constexpr (std::is_signed_v<T>) {
+        const int64_t v = n;
+        return v < 0 || v == std::numeric_limits<int64_t>::max() ? v : v + 1;
+    } else {
+        const uint64_t v = n;
+        return v == std::numeric_limits<uint64_t>::max() ? v : v + 1;
+    }
+}
+
+// 取循环规模（非法时按 0）
+template <typename SiteFn, typename T>
+inline uint64_t loopSizeValue(SiteFn&& siteFn, const T& source) {
+    uint64_t size = 0;
+    loopSizeOf(siteFn, source, size);
+    return size;
+}
+
+} // namespace LoopMonitor
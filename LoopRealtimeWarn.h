@@ -0,0 +1,275 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <execinfo.h>
+#include <mutex>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include "LoopSite.h"
+#include "LoopSink.h"
+
+// 实时线程告警：超标、截断、负数规模、熔断与请求预算耗尽都只向本线程的预分配环形缓冲写一条事件
+// （无锁、无分配、不阻塞，满了即丢），由后台格式化线程取出后再走常规输出
+// 前提：站点在启动阶段执行过一次（站点首次登记有局部静态初始化与配置表加锁）
+namespace LoopMonitorConfig {
+    // 开启后所有超标告警走实时路径
+    inline std::atomic<bool> ENABLE_REALTIME_WARN = false;
+    // 格式化线程的取件周期（毫秒）
+    inline std::atomic<uint64_t> REALTIME_DRAIN_MS = 50;
+}
+
+// 定义见 DynamicLoopCheck.cpp
+namespace LoopMonitorConfig {
+    extern std::atomic<bool> WARN_ONCE_PER_PROCESS;
+}
+[[gnu::cold]] [[gnu::noinline]] void loopWarn(const std::string& loopName, uint64_t loopSize, uint64_t threshold,
+                                              bool withStackTrace);
+
+namespace LoopMonitor {
+
+inline constexpr int kRealtimeWarnThreads = 64;
+inline constexpr uint32_t kRealtimeRingSize = 256;   // 2 的幂
+inline constexpr size_t kRealtimeRequestIdLen = 32;   // 请求 id 超长时截断
+
+enum class LoopRealtimeEventKind : uint8_t {
+    Violation,          // 规模/计数超标或预计超时
+    Clamp,              // 截断（threshold 为截断上限）
+    NegativeSize,       // 负数规模（loopSize 按 int64_t 解释）
+    Break,              // 熔断（message 为提示）
+    RequestExhausted,   // 请求预算耗尽（loopSize/threshold 为已用/上限迭代数）
+};
+
+struct LoopRealtimeEvent {
+    uint64_t timestampNs;
+    uint64_t loopSize;
+    uint64_t threshold;
+    void* caller;          // 告警调用点的返回地址（展开完整调用栈需加载器锁，实时路径不做）
+    uint32_t siteId;       // 熔断提示为 0
+    LoopRealtimeEventKind kind;
+    const char* message;   // 字符串字面量
+    uint64_t elapsedNs;    // 请求预算耗尽时的已用时间与时间上限
+    uint64_t budgetNs;
+    char requestId[kRealtimeRequestIdLen];
+};
+
+// 单生产者（所属线程）/单消费者（格式化线程）环
+struct alignas(64) LoopRealtimeRing {
+    std::atomic<bool> inUse{false};
+    std::atomic<pid_t> tid{0};
+    alignas(64) std::atomic<uint32_t> head{0};      // 生产者写
+    std::atomic<uint64_t> dropped{0};
+    alignas(64) std::atomic<uint32_t> tail{0};      // 消费者写
+    uint64_t reportedDropped = 0;                   // 仅格式化线程访问
+    LoopRealtimeEvent events[kRealtimeRingSize];
+};
+
+struct LoopRealtimeWarnState {
+    LoopRealtimeRing rings[kRealtimeWarnThreads];
+    std::atomic<uint64_t> unclaimedDropped{0};      // 环已用尽的线程丢弃的告警
+    std::atomic<bool> running{false};
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::thread thread;
+    ~LoopRealtimeWarnState();
+};
+
+inline LoopRealtimeWarnState LOOP_REALTIME_WARN;
+inline thread_local LoopRealtimeRing* LOOP_REALTIME_RING = nullptr;
+
+// 有界扫描认领一个空闲环（不注册线程退出回调，避免分配；死线程的环由格式化线程回收）
+inline LoopRealtimeRing* claimRealtimeRing() {
+    for (auto& ring : LOOP_REALTIME_WARN.rings) {
+        bool expected = false;
+        if (ring.inUse.load(std::memory_order_relaxed) ||
+            !ring.inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            continue;
+        }
+        ring.tid.store(static_cast<pid_t>(syscall(SYS_gettid)), std::memory_order_release);
+        LOOP_REALTIME_RING = &ring;
+        return &ring;
+    }
+    return nullptr;
+}
+
+// 写入一条事件：等待无关（每步都是有界操作），不分配、不加锁；fill 只填写 kind 及其专属字段
+template <typename Fill>
+inline void pushRealtimeEvent(uint32_t siteId, void* caller, Fill&& fill) noexcept {
+    LoopRealtimeRing* ring = LOOP_REALTIME_RING;
+    if (!ring) ring = claimRealtimeRing();
+    if (!ring) {
+        LOOP_REALTIME_WARN.unclaimedDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const uint32_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= kRealtimeRingSize) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    LoopRealtimeEvent& ev = ring->events[head & (kRealtimeRingSize - 1)];
+    ev.timestampNs = monotonicNs();
+    ev.caller = caller;
+    ev.siteId = siteId;
+    fill(ev);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+// 站点事件（超标/截断/负数规模）
+// caller 为空时取本函数的返回地址（库内冷路径转调时传入其调用方地址）
+[[gnu::cold]] [[gnu::noinline]] inline void loopWarnRealtime(
+    const LoopSite& site, uint64_t loopSize, uint64_t threshold, void* caller = nullptr,
+    LoopRealtimeEventKind kind = LoopRealtimeEventKind::Violation) noexcept {
+    pushRealtimeEvent(site.id, caller ? caller : __builtin_return_address(0), [&](LoopRealtimeEvent& ev) {
+        ev.kind = kind;
+        ev.loopSize = loopSize;
+        ev.threshold = threshold;
+    });
+}
+
+// 熔断提示（message 需为字符串字面量）
+[[gnu::cold]] [[gnu::noinline]] inline void loopBreakRealtime(const char* message, void* caller) noexcept {
+    pushRealtimeEvent(0, caller, [&](LoopRealtimeEvent& ev) {
+        ev.kind = LoopRealtimeEventKind::Break;
+        ev.message = message;
+    });
+}
+
+// 与同步路径输出同样的内容，再补一行线程/延迟/触发函数
+inline void formatRealtimeEvent(const LoopRealtimeRing& ring, const LoopRealtimeEvent& ev) {
+    const LoopSite* site = findLoopSiteById(ev.siteId);
+    const char* name = site ? site->name : "<unknown>";
+    switch (ev.kind) {
+    case LoopRealtimeEventKind::Violation:
+        // 与同步路径一致：告警开关已关闭时不再输出
+        if (!LoopMonitorConfig::WARN_ONCE_PER_PROCESS.load(std::memory_order_relaxed)) return;
+        loopWarn(name, ev.loopSize, ev.threshold, false);
+        break;
+    case LoopRealtimeEventKind::Clamp:
+        loopLog(LoopEventCategory::Warn, LoopEventLevel::Warning)
+            << "[LOOP_CLAMP] LoopName: " << name << " | N: " << ev.loopSize << " | Cap: " << ev.threshold
+            << " | 跳过: " << ev.loopSize - ev.threshold;
+        break;
+    case LoopRealtimeEventKind::NegativeSize:
+        loopLog(LoopEventCategory::Warn, LoopEventLevel::Warning)
+            << "[DYNAMIC_LOOP_WARN] LoopName: " << name << " | 循环次数为负数: "
+            << static_cast<int64_t>(ev.loopSize) << "（按 0 处理）";
+        break;
+    case LoopRealtimeEventKind::Break:
+        loopLog(LoopEventCategory::Break, LoopEventLevel::Error) << ev.message;
+        break;
+    case LoopRealtimeEventKind::RequestExhausted: {
+        auto out = loopLog(LoopEventCategory::Budget, LoopEventLevel::Warning);
+        out << "[LOOP_REQUEST_BUDGET] Request: " << ev.requestId << " | ExhaustedBy: " << name
+            << " | Iterations: " << ev.loopSize << " / " << ev.threshold
+            << " | Elapsed(ms): " << ev.elapsedNs / 1000000;
+        if (ev.budgetNs) out << " / " << ev.budgetNs / 1000000;
+        break;
+    }
+    }
+    auto out = loopLog(LoopEventCategory::Realtime, LoopEventLevel::Warning);
+    out << "[LOOP_RT] Thread: " << ring.tid.load(std::memory_order_relaxed)
+        << " | Delay(us): " << (monotonicNs() - ev.timestampNs) / 1000 << " | Caller: ";
+    if (char** sym = backtrace_symbols(&ev.caller, 1)) {
+        out << sym[0];
+        free(sym);
+    }
+}
+
+// 格式化线程：取出各环的事件，报告丢弃数；所属线程已退出且取空的环归还
+inline void drainRealtimeWarnings() {
+    for (auto& ring : LOOP_REALTIME_WARN.rings) {
+        if (!ring.inUse.load(std::memory_order_acquire)) continue;
+        uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+        const uint32_t head = ring.head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            formatRealtimeEvent(ring, ring.events[tail & (kRealtimeRingSize - 1)]);
+        }
+        ring.tail.store(tail, std::memory_order_release);
+        const uint64_t dropped = ring.dropped.load(std::memory_order_relaxed);
+        if (dropped != ring.reportedDropped) {
+            loopLog(LoopEventCategory::Realtime, LoopEventLevel::Warning)
+                << "[LOOP_RT] Thread: " << ring.tid.load(std::memory_order_relaxed)
+                << " | 环满丢弃告警: " << dropped - ring.reportedDropped;
+            ring.reportedDropped = dropped;
+        }
+        const pid_t tid = ring.tid.load(std::memory_order_acquire);
+        if (tid && syscall(SYS_tgkill, getpid(), tid, 0) != 0 && errno == ESRCH &&
+            ring.head.load(std::memory_order_acquire) == tail) {
+            ring.head.store(0, std::memory_order_relaxed);
+            ring.tail.store(0, std::memory_order_relaxed);
+            ring.dropped.store(0, std::memory_order_relaxed);
+            ring.reportedDropped = 0;
+            ring.tid.store(0, std::memory_order_relaxed);
+            ring.inUse.store(false, std::memory_order_release);
+        }
+    }
+}
+
+// 恢复同步告警并停止格式化线程（线程退出前取空一次，stopLoopRealtimeWarn 与进程退出共用）
+inline void stopRealtimeWarnThread(LoopRealtimeWarnState& st) {
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (!st.running.load()) return;
+        LoopMonitorConfig::ENABLE_REALTIME_WARN.store(false);
+        st.running.store(false);
+        t = std::move(st.thread);
+    }
+    st.wakeup.notify_all();
+    if (t.joinable()) t.join();
+}
+
+// 从 main 返回时仍在实时模式则在此汇合，否则 std::thread 析构会 terminate
+inline LoopRealtimeWarnState::~LoopRealtimeWarnState() {
+    stopRealtimeWarnThread(*this);
+}
+
+} // namespace LoopMonitor
+
+/**
+ * 19. 实时线程告警模式（超标路径无分配、无锁、不阻塞）
+ * 用法：startLoopRealtimeWarn(); // 之后的超标只写入线程本地预分配环，由后台线程格式化输出
+ * 说明：环满或线程数超过 64 时丢弃并计数；实时路径只记录触发函数地址，不展开完整调用栈；
+ *       超标/截断/负数规模/熔断/请求预算耗尽各路径无分配、无加锁由 tests/LoopRealtimeNoAllocTest.cpp 验证
+ */
+inline void startLoopRealtimeWarn(uint64_t drainMs = 50) {
+    auto& st = LoopMonitor::LOOP_REALTIME_WARN;
+    std::lock_guard<std::mutex> lock(st.mutex);
+    if (st.running.load()) return;
+    // 预热 backtrace_symbols 依赖的 libgcc/动态符号表
+    void* warmup[1];
+    backtrace(warmup, 1);
+    LoopMonitorConfig::REALTIME_DRAIN_MS.store(drainMs);
+    st.running.store(true);
+    st.thread = std::thread([] {
+        auto& s = LoopMonitor::LOOP_REALTIME_WARN;
+        std::unique_lock<std::mutex> lk(s.mutex);
+        uint64_t reportedUnclaimed = 0;
+        while (s.running.load()) {
+            s.wakeup.wait_for(lk, std::chrono::milliseconds(LoopMonitorConfig::REALTIME_DRAIN_MS.load()));
+            LoopMonitor::drainRealtimeWarnings();
+            const uint64_t unclaimed = s.unclaimedDropped.load(std::memory_order_relaxed);
+            if (unclaimed != reportedUnclaimed) {
+                LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Realtime, LoopMonitor::LoopEventLevel::Warning)
+                    << "[LOOP_RT] 环已用尽，丢弃告警: " << unclaimed - reportedUnclaimed;
+                reportedUnclaimed = unclaimed;
+            }
+        }
+    });
+    LoopMonitorConfig::ENABLE_REALTIME_WARN.store(true);
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config) << "[LOOP_CONFIG] 实时告警模式已开启";
+}
+
+/**
+ * 20. 关闭实时告警模式（取空剩余事件后恢复同步告警）
+ * 用法：stopLoopRealtimeWarn();
+ * 说明：未调用时进程退出（main 返回或 exit）会自动关闭
+ */
+inline void stopLoopRealtimeWarn() {
+    LoopMonitor::stopRealtimeWarnThread(LoopMonitor::LOOP_REALTIME_WARN);
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include "LoopSite.h"
+#include "LoopSink.h"
+#include "LoopRealtimeWarn.h"
+
+// 请求级预算：一次请求调用树里所有循环共用的迭代数/时间预算
+// 各线程先在本地累计扣减，攒够一批再合入共享计数，共享缓存行不会被每个循环争抢；
+// 时间预算另按扣减次数粗粒度地读时钟，循环短而慢的请求在运行中即可判定超时
+namespace LoopMonitor {
+
+// 本地累计达到该迭代数才合入共享计数（超支上限约为 批量 × 参与线程数）
+inline constexpr uint64_t kRequestBudgetFlushBatch = 65536;
+// 设了时间预算时每隔该次数的扣减读一次时钟（2 的幂；超时判定最多晚这么多次校验）
+inline constexpr uint64_t kRequestBudgetClockCheckCalls = 64;
+
+class LoopRequestBudget {
+public:
+    LoopRequestBudget(std::string requestId, uint64_t maxIterations, uint64_t maxTimeNs)
+        : requestId_(std::move(requestId)), maxIterations_(maxIterations), maxTimeNs_(maxTimeNs),
+          startNs_(monotonicNs()), deadlineNs_(maxTimeNs ? startNs_ + maxTimeNs : UINT64_MAX) {}
+
+    const std::string& requestId() const { return requestId_; }
+    uint64_t maxIterations() const { return maxIterations_; }
+    uint64_t maxTimeNs() const { return maxTimeNs_; }
+    uint64_t elapsedNs() const { return monotonicNs() - startNs_; }
+    // 时间预算的截止时刻（monotonicNs；不限时为 UINT64_MAX）
+    uint64_t deadlineNs() const { return deadlineNs_; }
+    // 已合入共享计数的迭代数（不含各线程尚未合入的部分）
+    uint64_t iterationsUsed() const { return used_.load(std::memory_order_relaxed); }
+    bool exhausted() const { return exhausted_.load(std::memory_order_relaxed); }
+    // 耗尽预算的站点（未耗尽时为 nullptr）
+    const LoopSite* exhaustedBy() const { return exhaustedSite_.load(std::memory_order_acquire); }
+
+    // 合入一批扣减；本次导致耗尽时返回 true（每个请求只有一个调用方会拿到 true）
+    bool commit(const LoopSite& site, uint64_t iterations) {
+        const uint64_t used = used_.fetch_add(iterations, std::memory_order_relaxed) + iterations;
+        const bool overIterations = maxIterations_ && used > maxIterations_;
+        const bool overTime = maxTimeNs_ && elapsedNs() > maxTimeNs_;
+        if (!overIterations && !overTime) return false;
+        if (exhausted_.exchange(true, std::memory_order_relaxed)) return false;
+        exhaustedSite_.store(&site, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::string requestId_;
+    uint64_t maxIterations_;   // 0 表示不限
+    uint64_t maxTimeNs_;       // 0 表示不限
+    uint64_t startNs_;
+    uint64_t deadlineNs_;
+    alignas(64) std::atomic<uint64_t> used_{0};
+    alignas(64) std::atomic<bool> exhausted_{false};
+    std::atomic<const LoopSite*> exhaustedSite_{nullptr};
+};
+
+// 线程当前所属请求与本地未合入的扣减
+struct LoopRequestContext {
+    LoopRequestBudget* budget = nullptr;
+    const LoopSite* lastSite = nullptr;
+    uint64_t pending = 0;
+    uint64_t calls = 0;   // 扣减次数（时钟检查节拍）
+};
+
+inline thread_local LoopRequestContext LOOP_REQUEST_CONTEXT;
+// 持有当前请求的所有权（与 LOOP_REQUEST_CONTEXT.budget 同步，热路径只读裸指针）
+inline thread_local std::shared_ptr<LoopRequestBudget> LOOP_REQUEST_OWNER;
+
+[[gnu::cold]] [[gnu::noinline]] inline void reportLoopRequestExhausted(const LoopRequestBudget& budget,
+                                                                         const LoopSite& site) {
+    if (LoopMonitorConfig::ENABLE_REALTIME_WARN.load(std::memory_order_relaxed)) {
+        pushRealtimeEvent(site.id, __builtin_return_address(0), [&](LoopRealtimeEvent& ev) {
+            ev.kind = LoopRealtimeEventKind::RequestExhausted;
+            ev.loopSize = budget.iterationsUsed();
+            ev.threshold = budget.maxIterations();
+            ev.elapsedNs = budget.elapsedNs();
+            ev.budgetNs = budget.maxTimeNs();
+            ev.requestId[budget.requestId().copy(ev.requestId, kRealtimeRequestIdLen - 1)] = '\0';
+        });
+        return;
+    }
+    auto out = loopLog(LoopEventCategory::Budget, LoopEventLevel::Warning);
+    out << "[LOOP_REQUEST_BUDGET] Request: " << budget.requestId() << " | ExhaustedBy: " << site.name
+        << " | Iterations: " << budget.iterationsUsed() << " / " << budget.maxIterations()
+        << " | Elapsed(ms): " << budget.elapsedNs() / 1000000;
+    if (budget.maxTimeNs()) out << " / " << budget.maxTimeNs() / 1000000;
+}
+
+// 把本地累计合入共享计数
+inline bool flushLoopRequestDebit(LoopRequestContext& ctx) {
+    if (!ctx.budget || ctx.pending == 0) return false;
+    const uint64_t pending = std::exchange(ctx.pending, 0);
+    if (ctx.budget->commit(*ctx.lastSite, pending)) {
+        reportLoopRequestExhausted(*ctx.budget, *ctx.lastSite);
+        return true;
+    }
+    return false;
+}
+
+// 时钟检查节拍：已过截止时刻则合入本地扣减（可能为 0）并判定耗尽
+[[gnu::cold]] [[gnu::noinline]] inline void checkLoopRequestDeadline(LoopRequestContext& ctx) {
+    if (ctx.budget->exhausted() || monotonicNs() <= ctx.budget->deadlineNs()) return;
+    const uint64_t pending = std::exchange(ctx.pending, 0);
+    if (ctx.budget->commit(*ctx.lastSite, pending)) reportLoopRequestExhausted(*ctx.budget, *ctx.lastSite);
+}
+
+// 热路径：本地累加，攒满一批才触碰共享计数；设了时间预算时每 kRequestBudgetClockCheckCalls 次读一次时钟
+// 返回 true 表示请求预算已耗尽
+inline bool debitLoopRequest(const LoopSite& site, uint64_t iterations) {
+    LoopRequestContext& ctx = LOOP_REQUEST_CONTEXT;
+    if (!ctx.budget) return false;
+    ctx.pending += iterations;
+    ctx.lastSite = &site;
+    if (ctx.pending >= kRequestBudgetFlushBatch) [[unlikely]] {
+        flushLoopRequestDebit(ctx);
+    } else if ((++ctx.calls & (kRequestBudgetClockCheckCalls - 1)) == 0 &&
+               ctx.budget->deadlineNs() != UINT64_MAX) [[unlikely]] {
+        checkLoopRequestDeadline(ctx);
+    }
+    return ctx.budget->exhausted();
+}
+
+// 请求作用域：在当前线程安装预算，退出时合入剩余扣减并恢复外层请求
+// 跨线程传递：worker 里用 currentLoopRequestBudget() 拿到的指针再建一个作用域
+class LoopRequestScope {
+public:
+    explicit LoopRequestScope(std::shared_ptr<LoopRequestBudget> budget)
+        : prevOwner_(std::move(LOOP_REQUEST_OWNER)) {
+        LoopRequestContext& ctx = LOOP_REQUEST_CONTEXT;
+        flushLoopRequestDebit(ctx);
+        prevSite_ = ctx.lastSite;
+        LOOP_REQUEST_OWNER = std::move(budget);
+        ctx.budget = LOOP_REQUEST_OWNER.get();
+    }
+
+    ~LoopRequestScope() {
+        LoopRequestContext& ctx = LOOP_REQUEST_CONTEXT;
+        flushLoopRequestDebit(ctx);
+        LOOP_REQUEST_OWNER = std::move(prevOwner_);
+        ctx.budget = LOOP_REQUEST_OWNER.get();
+        ctx.lastSite = prevSite_;
+    }
+
+    LoopRequestScope(const LoopRequestScope&) = delete;
+    LoopRequestScope& operator=(const LoopRequestScope&) = delete;
+
+private:
+    std::shared_ptr<LoopRequestBudget> prevOwner_;
+    const LoopSite* prevSite_ = nullptr;
+};
+
+} // namespace LoopMonitor
+
+/**
+ * 17. 创建请求级预算（调用树内所有循环共用）
+ * 用法：LOOP_REQUEST_SCOPE(makeLoopRequestBudget("req-42", 50000000, 200));
+ *       // 该作用域内（及传递到的 worker 线程）所有守卫/校验累计超过 5000 万次或 200ms 即告警
+ * 说明：只统计 checkLoopSize 路径（GUARD / CHECK_LOOP_DYNAMIC_SIZE / 有界下标）；
+ *       迭代数每线程攒满 65536 次合入一次，时间每 64 次校验读一次时钟，两者都在请求运行中判定，不必等作用域结束；
+ *       耗尽后这些校验返回超标，开启熔断时后续循环直接跳过；告警归属请求 id 与耗尽它的站点
+ */
+inline std::shared_ptr<LoopMonitor::LoopRequestBudget> makeLoopRequestBudget(std::string requestId,
+                                                                             uint64_t maxIterations,
+                                                                             uint64_t maxTimeMs = 0) {
+    return std::make_shared<LoopMonitor::LoopRequestBudget>(std::move(requestId), maxIterations,
+                                                            maxTimeMs * 1000000);
+}
+
+/**
+ * 18. 取当前线程所属的请求预算（跨线程传递用）
+ * 用法：pool.submit([b = currentLoopRequestBudget()] { LOOP_REQUEST_SCOPE(b); ... });
+ */
+inline std::shared_ptr<LoopMonitor::LoopRequestBudget> currentLoopRequestBudget() {
+    return LoopMonitor::LOOP_REQUEST_OWNER;
+}
+
+// 在当前作用域安装请求预算（传入空指针表示脱离请求）
+#define LOOP_REQUEST_SCOPE(BUDGET) \
+    LoopMonitor::LoopRequestScope LOOP_MONITOR_CONCAT(loopRequestScope_, __LINE__)(BUDGET)
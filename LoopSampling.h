@@ -0,0 +1,32 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include "LoopSite.h"
+
+// 概率采样：热点站点只对 1/N 的调用做完整记录（直方图/计时/栈），阈值比较仍每次执行
+namespace LoopMonitor {
+
+// 线程私有 xorshift64 状态（0 表示未播种）
+inline thread_local uint64_t LOOP_SAMPLE_STATE = 0;
+
+[[gnu::noinline]] inline void seedLoopSampler() {
+    // 线程私有变量地址 + 时钟，保证各线程序列不同
+    uint64_t seed = reinterpret_cast<uintptr_t>(&LOOP_SAMPLE_STATE) ^
+                    static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    LOOP_SAMPLE_STATE = seed ? seed : 0x9E3779B97F4A7C15ull;
+}
+
+// 以 1/rate 的概率返回 true（rate ≤ 1 时恒为 true）
+inline bool shouldSampleLoop(uint32_t rate) {
+    if (rate <= 1) return true;
+    if (LOOP_SAMPLE_STATE == 0) [[unlikely]] seedLoopSampler();
+    uint64_t x = LOOP_SAMPLE_STATE;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    LOOP_SAMPLE_STATE = x;
+    // 乘法取区间代替取模：高 32 位映射到 [0, rate)
+    return (((x >> 32) * rate) >> 32) == 0;
+}
+
+} // namespace LoopMonitor
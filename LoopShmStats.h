@@ -0,0 +1,334 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include "LoopSite.h"
+#include "LoopSink.h"
+
+// 共享内存统计段：外部进程只读映射、轮询，不与被监控进程交互
+// 布局固定且带版本号；每条记录用 seqlock 保护，读者遇到写入中（奇数）或前后不一致时重读
+namespace LoopMonitorConfig {
+    // 发布周期（毫秒）
+    inline std::atomic<uint64_t> SHM_PUBLISH_INTERVAL_MS = 1000;
+}
+
+namespace LoopMonitor {
+
+inline constexpr uint64_t kLoopShmMagic = 0x314D48535043504CULL;   // "LPCPSHM1"
+inline constexpr uint32_t kLoopShmVersion = 1;
+inline constexpr size_t kLoopShmNameLen = 64;
+
+struct alignas(64) LoopShmHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t capacity;
+    int32_t pid;
+    uint32_t reserved;
+    uint64_t startTimeNs;                 // 进程启动墙钟时间
+    std::atomic<uint32_t> siteCount;      // 已发布的最大站点 id
+    std::atomic<uint64_t> publishSeq;     // 每轮发布 +1
+    std::atomic<uint64_t> publishTimeNs;  // 最近一轮发布的墙钟时间
+};
+
+// 记录按站点 id 排列（下标 = id - 1）
+struct alignas(64) LoopShmRecord {
+    std::atomic<uint32_t> seq;            // seqlock：奇数表示写入中
+    uint32_t siteId;
+    char name[kLoopShmNameLen];           // 首次发布时写入，之后不变
+    std::atomic<uint64_t> invocations;
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> iterations;
+    std::atomic<uint64_t> maxN;
+    std::atomic<uint64_t> violations;
+    std::atomic<uint64_t> timedInvocations;
+    std::atomic<uint64_t> totalNs;
+    std::atomic<uint64_t> threshold;      // 生效阈值（0 表示全局）
+    std::atomic<uint32_t> sampleRate;
+};
+
+// 读者拿到的一致快照
+struct LoopShmRecordView {
+    uint32_t siteId = 0;
+    char name[kLoopShmNameLen] = {};
+    uint64_t invocations = 0;
+    uint64_t samples = 0;
+    uint64_t iterations = 0;
+    uint64_t maxN = 0;
+    uint64_t violations = 0;
+    uint64_t timedInvocations = 0;
+    uint64_t totalNs = 0;
+    uint64_t threshold = 0;
+    uint32_t sampleRate = 1;
+};
+
+inline size_t loopShmSegmentSize(uint32_t capacity) {
+    return sizeof(LoopShmHeader) + sizeof(LoopShmRecord) * capacity;
+}
+
+inline std::string loopShmName(int pid) {
+    return "/loopmon." + std::to_string(pid);
+}
+
+inline uint64_t wallClockNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+struct LoopShmPublisherState {
+    LoopShmHeader* header = nullptr;
+    LoopShmRecord* records = nullptr;
+    size_t size = 0;
+    std::string name;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    ~LoopShmPublisherState();
+};
+
+inline LoopShmPublisherState LOOP_SHM_PUBLISHER;
+
+// 单写者：只由发布线程（或持锁的手动发布）调用
+inline void writeLoopShmRecord(LoopShmRecord& rec, const LoopSite& site, const LoopSiteSnapshot& s) {
+    constexpr auto r = std::memory_order_relaxed;
+    const uint32_t seq = rec.seq.load(r);
+    rec.seq.store(seq + 1, r);
+    std::atomic_thread_fence(std::memory_order_release);
+    rec.invocations.store(s.invocations, r);
+    rec.samples.store(s.samples, r);
+    rec.iterations.store(s.iterations, r);
+    rec.maxN.store(s.maxN, r);
+    rec.violations.store(s.violations, r);
+    rec.timedInvocations.store(s.timedInvocations, r);
+    rec.totalNs.store(s.totalNs, r);
+    rec.threshold.store(site.threshold.load(r), r);
+    rec.sampleRate.store(site.sampleRate.load(r), r);
+    rec.seq.store(seq + 2, std::memory_order_release);
+}
+
+inline void publishLoopShmLocked(LoopShmPublisherState& st) {
+    if (!st.header) return;
+    uint32_t maxId = st.header->siteCount.load(std::memory_order_relaxed);
+    forEachLoopSite([&](const LoopSite& site) {
+        if (site.id > st.header->capacity) return;
+        LoopShmRecord& rec = st.records[site.id - 1];
+        if (rec.siteId == 0) {
+            std::strncpy(rec.name, site.name, kLoopShmNameLen - 1);
+            rec.siteId = site.id;
+        }
+        writeLoopShmRecord(rec, site, snapshotLoopSite(site));
+        if (site.id > maxId) maxId = site.id;
+    });
+    // 名字与首轮数据写完后再放大 siteCount，读者看到的记录都已初始化
+    st.header->siteCount.store(maxId, std::memory_order_release);
+    st.header->publishTimeNs.store(wallClockNs(), std::memory_order_relaxed);
+    st.header->publishSeq.fetch_add(1, std::memory_order_release);
+}
+
+// 只读映射的读者（loopstat 等外部工具使用）
+class LoopShmReader {
+public:
+    LoopShmReader() = default;
+    ~LoopShmReader() { close(); }
+    LoopShmReader(const LoopShmReader&) = delete;
+    LoopShmReader& operator=(const LoopShmReader&) = delete;
+    LoopShmReader(LoopShmReader&& o) noexcept { *this = std::move(o); }
+    LoopShmReader& operator=(LoopShmReader&& o) noexcept {
+        if (this != &o) {
+            close();
+            header_ = o.header_;
+            size_ = o.size_;
+            dev_ = o.dev_;
+            ino_ = o.ino_;
+            o.header_ = nullptr;
+            o.size_ = 0;
+        }
+        return *this;
+    }
+
+    // name 形如 "/loopmon.1234"；布局版本不符时返回 false
+    bool open(const std::string& name) {
+        close();
+        const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(LoopShmHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        header_ = static_cast<const LoopShmHeader*>(p);
+        size_ = static_cast<size_t>(st.st_size);
+        dev_ = st.st_dev;
+        ino_ = st.st_ino;
+        if (header_->magic != kLoopShmMagic || header_->version != kLoopShmVersion ||
+            header_->recordSize != sizeof(LoopShmRecord) ||
+            size_ < loopShmSegmentSize(header_->capacity)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // 同 pid 的进程重启（或停止后重新发布）时旧段已删除、新段是另一个文件，旧映射永远停在旧数据上：
+    // 重新打开名字比对 inode，换了文件则重新映射并返回 true，调用方据此丢弃旧读数；
+    // 段已不存在（进程正在退出）时保留旧映射。重新映射失败时 isOpen() 为 false
+    bool remapIfReplaced(const std::string& name) {
+        const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        struct stat st {};
+        const bool same = fstat(fd, &st) == 0 && st.st_dev == dev_ && st.st_ino == ino_;
+        ::close(fd);
+        if (same) return false;
+        open(name);
+        return true;
+    }
+
+    void close() {
+        if (header_) munmap(const_cast<LoopShmHeader*>(header_), size_);
+        header_ = nullptr;
+        size_ = 0;
+        dev_ = 0;
+        ino_ = 0;
+    }
+
+    bool isOpen() const { return header_ != nullptr; }
+    const LoopShmHeader& header() const { return *header_; }
+    uint32_t siteCount() const { return header_->siteCount.load(std::memory_order_acquire); }
+
+    // 读第 index 条记录（0 起）；写者长时间占用时放弃并返回 false
+    bool read(uint32_t index, LoopShmRecordView& out) const {
+        const auto* records = reinterpret_cast<const LoopShmRecord*>(
+            reinterpret_cast<const char*>(header_) + header_->headerSize);
+        const LoopShmRecord& rec = records[index];
+        constexpr auto r = std::memory_order_relaxed;
+        for (int attempt = 0; attempt < 64; ++attempt) {
+            const uint32_t before = rec.seq.load(std::memory_order_acquire);
+            if (before & 1u) continue;
+            out.siteId = rec.siteId;
+            std::memcpy(out.name, rec.name, kLoopShmNameLen);
+            out.name[kLoopShmNameLen - 1] = '\0';
+            out.invocations = rec.invocations.load(r);
+            out.samples = rec.samples.load(r);
+            out.iterations = rec.iterations.load(r);
+            out.maxN = rec.maxN.load(r);
+            out.violations = rec.violations.load(r);
+            out.timedInvocations = rec.timedInvocations.load(r);
+            out.totalNs = rec.totalNs.load(r);
+            out.threshold = rec.threshold.load(r);
+            out.sampleRate = rec.sampleRate.load(r);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (rec.seq.load(r) == before) return out.siteId != 0;
+        }
+        return false;
+    }
+
+private:
+    const LoopShmHeader* header_ = nullptr;
+    size_t size_ = 0;
+    dev_t dev_ = 0;   // 映射的段文件，remapIfReplaced 据此判断是否被删除重建
+    ino_t ino_ = 0;
+};
+
+// 停止发布线程（退出前补发一次），解除映射并删除段（stopLoopShmPublisher 与进程退出共用）
+inline void stopLoopShmPublisherThread(LoopShmPublisherState& st) {
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (!st.running.load()) return;
+        st.running.store(false);
+        t = std::move(st.thread);
+    }
+    st.wakeup.notify_all();
+    if (t.joinable()) t.join();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    munmap(st.header, st.size);
+    shm_unlink(st.name.c_str());
+    st.header = nullptr;
+    st.records = nullptr;
+}
+
+// 从 main 返回时仍在发布则在此汇合线程并删除 /dev/shm/loopmon.<pid>，不留残段
+inline LoopShmPublisherState::~LoopShmPublisherState() {
+    stopLoopShmPublisherThread(*this);
+}
+
+} // namespace LoopMonitor
+
+/**
+ * 13. 发布统计到共享内存（/dev/shm/loopmon.<pid>）
+ * 用法：startLoopShmPublisher(1000); // 每秒发布一次，loopstat 等工具只读映射查看
+ * 说明：发布在后台线程完成，被监控线程无额外开销；每条记录一次 seqlock 写（若干 relaxed store）
+ */
+inline bool startLoopShmPublisher(uint64_t intervalMs = 1000) {
+    auto& st = LoopMonitor::LOOP_SHM_PUBLISHER;
+    std::lock_guard<std::mutex> lock(st.mutex);
+    if (st.running.load()) return true;
+
+    const uint32_t capacity = LoopMonitor::kMaxLoopSites;
+    st.name = LoopMonitor::loopShmName(static_cast<int>(getpid()));
+    st.size = LoopMonitor::loopShmSegmentSize(capacity);
+    const int fd = shm_open(st.name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(st.size)) != 0) {
+        if (fd >= 0) ::close(fd);
+        LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Shm, LoopMonitor::LoopEventLevel::Error)
+            << "[LOOP_SHM] 创建共享内存失败: " << st.name;
+        return false;
+    }
+    void* p = mmap(nullptr, st.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(st.name.c_str());
+        LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Shm, LoopMonitor::LoopEventLevel::Error)
+            << "[LOOP_SHM] 映射共享内存失败: " << st.name;
+        return false;
+    }
+    // ftruncate 出来的页全为 0，只需填写头部；magic 最后写，读者据此判断段已就绪
+    st.header = static_cast<LoopMonitor::LoopShmHeader*>(p);
+    st.records = reinterpret_cast<LoopMonitor::LoopShmRecord*>(static_cast<char*>(p) + sizeof(LoopMonitor::LoopShmHeader));
+    st.header->version = LoopMonitor::kLoopShmVersion;
+    st.header->headerSize = sizeof(LoopMonitor::LoopShmHeader);
+    st.header->recordSize = sizeof(LoopMonitor::LoopShmRecord);
+    st.header->capacity = capacity;
+    st.header->pid = static_cast<int32_t>(getpid());
+    st.header->startTimeNs = LoopMonitor::wallClockNs();
+    std::atomic_thread_fence(std::memory_order_release);
+    st.header->magic = LoopMonitor::kLoopShmMagic;
+
+    LoopMonitorConfig::SHM_PUBLISH_INTERVAL_MS.store(intervalMs);
+    st.running.store(true);
+    st.thread = std::thread([] {
+        auto& s = LoopMonitor::LOOP_SHM_PUBLISHER;
+        std::unique_lock<std::mutex> lk(s.mutex);
+        while (s.running.load()) {
+            LoopMonitor::publishLoopShmLocked(s);
+            s.wakeup.wait_for(lk, std::chrono::milliseconds(LoopMonitorConfig::SHM_PUBLISH_INTERVAL_MS.load()));
+        }
+        LoopMonitor::publishLoopShmLocked(s);
+    });
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config) << "[LOOP_CONFIG] 共享内存统计已发布: /dev/shm" << st.name;
+    return true;
+}
+
+/**
+ * 14. 停止发布并删除共享内存段
+ * 用法：stopLoopShmPublisher();
+ * 说明：未调用时进程正常退出（main 返回或 exit）会自动停止并删除段；被信号杀死时段会残留，loopstat 按 pid 判断存活
+ */
+inline void stopLoopShmPublisher() {
+    LoopMonitor::stopLoopShmPublisherThread(LoopMonitor::LOOP_SHM_PUBLISHER);
+}
@@ -0,0 +1,396 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+// 输出通道：所有监控输出先形成事件，未配置输出通道时同步写 std::cerr（保持原有行为）；
+// addLoopSink 之后改为入队，由后台线程按批量或定时分发给各通道，慢通道只拖慢后台线程
+namespace LoopMonitorConfig {
+    // 攒够该条数立即唤醒后台线程
+    inline std::atomic<uint32_t> SINK_BATCH_SIZE = 64;
+    // 最长攒批时间（毫秒）
+    inline std::atomic<uint64_t> SINK_FLUSH_INTERVAL_MS = 200;
+    // 队列上限，超出丢弃（只计数）
+    inline std::atomic<uint32_t> SINK_QUEUE_LIMIT = 65536;
+}
+
+namespace LoopMonitor {
+
+// 事件类别（位掩码，供通道过滤）
+enum class LoopEventCategory : uint32_t {
+    Warn = 1u << 0,         // [DYNAMIC_LOOP_WARN]
+    StackTrace = 1u << 1,
+    Break = 1u << 2,        // [LOOP_BREAK]
+    Config = 1u << 3,       // [LOOP_CONFIG]
+    Perf = 1u << 4,         // [LOOP_PERF]
+    Adaptive = 1u << 5,     // [LOOP_ADAPTIVE]
+    Alloc = 1u << 6,        // [LOOP_ALLOC]
+    Budget = 1u << 7,       // [LOOP_REQUEST_BUDGET]
+    Watchdog = 1u << 8,     // [LOOP_WATCHDOG]
+    Realtime = 1u << 9,     // [LOOP_RT]
+    Shm = 1u << 10,         // [LOOP_SHM]
+    Collector = 1u << 11,   // [LOOP_COLLECTOR]
+};
+
+inline constexpr uint32_t kAllLoopEventCategories = ~0u;
+
+enum class LoopEventLevel : uint8_t { Info = 0, Warning = 1, Error = 2 };
+
+struct LoopEvent {
+    uint64_t timestampNs = 0;   // 墙钟时间
+    LoopEventCategory category = LoopEventCategory::Warn;
+    LoopEventLevel level = LoopEventLevel::Info;
+    std::string text;           // 可含多行，不含结尾换行
+};
+
+struct LoopSinkFilter {
+    uint32_t categories = kAllLoopEventCategories;
+    LoopEventLevel minLevel = LoopEventLevel::Info;
+
+    bool accepts(const LoopEvent& e) const {
+        return (categories & static_cast<uint32_t>(e.category)) && e.level >= minLevel;
+    }
+};
+
+// 通道接口：write 只在后台线程（或 flushLoopSinks 调用方）上串行调用
+class LoopSink {
+public:
+    virtual ~LoopSink() = default;
+    virtual void write(const std::vector<const LoopEvent*>& batch) = 0;
+    virtual void flush() {}
+};
+
+class LoopStderrSink : public LoopSink {
+public:
+    void write(const std::vector<const LoopEvent*>& batch) override {
+        std::string out;
+        for (const LoopEvent* e : batch) {
+            out += e->text;
+            out += '\n';
+        }
+        std::cerr << out;
+    }
+    void flush() override { std::cerr.flush(); }
+};
+
+// 按大小滚动的本地文件：path -> path.1 -> ... -> path.<maxFiles>
+class LoopRotatingFileSink : public LoopSink {
+public:
+    LoopRotatingFileSink(std::string path, uint64_t maxBytes = 64ull << 20, int maxFiles = 5)
+        : path_(std::move(path)), maxBytes_(maxBytes), maxFiles_(maxFiles) {
+        open();
+    }
+    ~LoopRotatingFileSink() override {
+        if (file_) std::fclose(file_);
+    }
+
+    void write(const std::vector<const LoopEvent*>& batch) override {
+        for (const LoopEvent* e : batch) {
+            if (!file_) return;
+            std::fwrite(e->text.data(), 1, e->text.size(), file_);
+            std::fputc('\n', file_);
+            size_ += e->text.size() + 1;
+            if (size_ >= maxBytes_) rotate();
+        }
+    }
+    void flush() override {
+        if (file_) std::fflush(file_);
+    }
+
+private:
+    void open() {
+        file_ = std::fopen(path_.c_str(), "a");
+        size_ = 0;
+        if (file_) {
+            std::fseek(file_, 0, SEEK_END);
+            size_ = static_cast<uint64_t>(std::ftell(file_));
+        }
+    }
+
+    void rotate() {
+        std::fclose(file_);
+        for (int i = maxFiles_ - 1; i >= 1; --i) {
+            std::rename((path_ + "." + std::to_string(i)).c_str(), (path_ + "." + std::to_string(i + 1)).c_str());
+        }
+        std::rename(path_.c_str(), (path_ + ".1").c_str());
+        open();
+    }
+
+    std::string path_;
+    uint64_t maxBytes_;
+    int maxFiles_;
+    FILE* file_ = nullptr;
+    uint64_t size_ = 0;
+};
+
+// 内存环：保留最近 capacity 条，供进程内查询（如调试接口）
+class LoopMemorySink : public LoopSink {
+public:
+    explicit LoopMemorySink(size_t capacity = 1024) : capacity_(capacity) {}
+
+    void write(const std::vector<const LoopEvent*>& batch) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const LoopEvent* e : batch) {
+            if (events_.size() == capacity_) events_.pop_front();
+            events_.push_back(*e);
+        }
+    }
+
+    std::vector<LoopEvent> snapshot() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return {events_.begin(), events_.end()};
+    }
+
+private:
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    std::deque<LoopEvent> events_;
+};
+
+// 用户回调（逐条调用，运行在后台线程）
+class LoopCallbackSink : public LoopSink {
+public:
+    explicit LoopCallbackSink(std::function<void(const LoopEvent&)> fn) : fn_(std::move(fn)) {}
+    void write(const std::vector<const LoopEvent*>& batch) override {
+        for (const LoopEvent* e : batch) fn_(*e);
+    }
+
+private:
+    std::function<void(const LoopEvent&)> fn_;
+};
+
+// syslog 风格数据报（RFC 3164 格式，默认发往 /dev/log；非阻塞，失败丢弃）
+class LoopSyslogSink : public LoopSink {
+public:
+    explicit LoopSyslogSink(std::string socketPath = "/dev/log", std::string ident = "loopmon", int facility = 1)
+        : ident_(std::move(ident)), facility_(facility) {
+        addr_.sun_family = AF_UNIX;
+        std::strncpy(addr_.sun_path, socketPath.c_str(), sizeof(addr_.sun_path) - 1);
+        fd_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    }
+    ~LoopSyslogSink() override {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    void write(const std::vector<const LoopEvent*>& batch) override {
+        if (fd_ < 0) return;
+        for (const LoopEvent* e : batch) {
+            // Info -> info(6)，Warning -> warning(4)，Error -> err(3)
+            const int severity = e->level == LoopEventLevel::Error ? 3 : e->level == LoopEventLevel::Warning ? 4 : 6;
+            const std::string msg = "<" + std::to_string(facility_ * 8 + severity) + ">" + ident_ + "[" +
+                                    std::to_string(getpid()) + "]: " + e->text;
+            if (sendto(fd_, msg.data(), msg.size(), MSG_DONTWAIT | MSG_NOSIGNAL,
+                       reinterpret_cast<const sockaddr*>(&addr_), sizeof(addr_)) < 0) {
+                ++dropped_;
+            }
+        }
+    }
+
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    std::string ident_;
+    int facility_;
+    sockaddr_un addr_ {};
+    int fd_ = -1;
+    uint64_t dropped_ = 0;
+};
+
+struct LoopSinkEntry {
+    std::shared_ptr<LoopSink> sink;
+    LoopSinkFilter filter;
+};
+
+struct LoopSinkDispatcher {
+    std::mutex mutex;                  // 保护 queue / sinks / running
+    std::mutex writeMutex;             // 串行化通道写入
+    std::condition_variable wakeup;
+    std::vector<LoopEvent> queue;
+    std::vector<LoopSinkEntry> sinks;
+    std::atomic<bool> active{false};   // 有通道时为 true，事件走队列
+    std::atomic<uint64_t> dropped{0};
+    bool running = false;
+    std::thread thread;
+
+    ~LoopSinkDispatcher();
+};
+
+inline LoopSinkDispatcher LOOP_SINKS;
+
+inline uint64_t loopEventWallClockNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// 取出当前队列并分发（后台线程与 flushLoopSinks 共用）
+inline void drainLoopSinks(LoopSinkDispatcher& d) {
+    std::lock_guard<std::mutex> writeLock(d.writeMutex);
+    std::vector<LoopEvent> events;
+    std::vector<LoopSinkEntry> sinks;
+    {
+        std::lock_guard<std::mutex> lock(d.mutex);
+        events.swap(d.queue);
+        sinks = d.sinks;
+    }
+    if (events.empty()) return;
+    std::vector<const LoopEvent*> batch;
+    batch.reserve(events.size());
+    for (const LoopSinkEntry& entry : sinks) {
+        batch.clear();
+        for (const LoopEvent& e : events) {
+            if (entry.filter.accepts(e)) batch.push_back(&e);
+        }
+        if (batch.empty()) continue;
+        entry.sink->write(batch);
+        entry.sink->flush();
+    }
+}
+
+inline void stopLoopSinkThread(LoopSinkDispatcher& d) {
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(d.mutex);
+        d.running = false;
+        t = std::move(d.thread);
+    }
+    d.wakeup.notify_all();
+    if (t.joinable()) t.join();
+    drainLoopSinks(d);
+}
+
+// 进程退出时补齐未输出的事件
+inline LoopSinkDispatcher::~LoopSinkDispatcher() {
+    active.store(false);
+    stopLoopSinkThread(*this);
+}
+
+// 所有监控输出的入口
+inline void emitLoopEvent(LoopEventCategory category, LoopEventLevel level, std::string text) {
+    LoopSinkDispatcher& d = LOOP_SINKS;
+    if (!d.active.load(std::memory_order_acquire)) {
+        std::cerr << text << std::endl;
+        return;
+    }
+    LoopEvent event;
+    event.timestampNs = loopEventWallClockNs();
+    event.category = category;
+    event.level = level;
+    event.text = std::move(text);
+    bool queued = false;
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(d.mutex);
+        // 锁内再看一次：clearLoopSinks 在锁内关闭 active，之后入队的事件赶不上最后一次分发，
+        // 会留在队列里交给下一次 addLoopSink 的通道，这里改为同步输出
+        if (d.active.load(std::memory_order_relaxed)) {
+            if (d.queue.size() >= LoopMonitorConfig::SINK_QUEUE_LIMIT.load(std::memory_order_relaxed)) {
+                d.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            d.queue.push_back(std::move(event));
+            queued = true;
+            wake = d.queue.size() >= LoopMonitorConfig::SINK_BATCH_SIZE.load(std::memory_order_relaxed);
+        }
+    }
+    if (!queued) {
+        std::cerr << event.text << std::endl;
+        return;
+    }
+    if (wake) d.wakeup.notify_one();
+}
+
+// 流式拼装一条事件，析构时发出：loopLog(LoopEventCategory::Config) << "[LOOP_CONFIG] ..." << x;
+class LoopEventWriter {
+public:
+    LoopEventWriter(LoopEventCategory category, LoopEventLevel level) : category_(category), level_(level) {}
+    ~LoopEventWriter() { emitLoopEvent(category_, level_, os_.str()); }
+
+    template <typename T>
+    LoopEventWriter& operator<<(const T& value) {
+        os_ << value;
+        return *this;
+    }
+
+    LoopEventWriter(const LoopEventWriter&) = delete;
+    LoopEventWriter& operator=(const LoopEventWriter&) = delete;
+
+private:
+    LoopEventCategory category_;
+    LoopEventLevel level_;
+    std::ostringstream os_;
+};
+
+inline LoopEventWriter loopLog(LoopEventCategory category, LoopEventLevel level = LoopEventLevel::Info) {
+    return LoopEventWriter(category, level);
+}
+
+} // namespace LoopMonitor
+
+/**
+ * 21. 添加输出通道（可叠加多个，各带过滤条件）
+ * 用法：addLoopSink(std::make_shared<LoopMonitor::LoopRotatingFileSink>("/var/log/loopmon.log"));
+ *       addLoopSink(std::make_shared<LoopMonitor::LoopSyslogSink>(),
+ *                   {static_cast<uint32_t>(LoopMonitor::LoopEventCategory::Warn), LoopMonitor::LoopEventLevel::Warning});
+ * 说明：添加第一个通道后输出改为异步：入队即返回，后台线程攒够 SINK_BATCH_SIZE 条或
+ *       SINK_FLUSH_INTERVAL_MS 到期时分发；不再默认写 std::cerr，需要时显式添加 LoopStderrSink
+ */
+inline void addLoopSink(std::shared_ptr<LoopMonitor::LoopSink> sink, LoopMonitor::LoopSinkFilter filter = {}) {
+    auto& d = LoopMonitor::LOOP_SINKS;
+    std::lock_guard<std::mutex> lock(d.mutex);
+    d.sinks.push_back({std::move(sink), filter});
+    d.active.store(true, std::memory_order_release);
+    if (d.running) return;
+    d.running = true;
+    d.thread = std::thread([] {
+        auto& s = LoopMonitor::LOOP_SINKS;
+        std::unique_lock<std::mutex> lk(s.mutex);
+        while (s.running) {
+            s.wakeup.wait_for(lk, std::chrono::milliseconds(LoopMonitorConfig::SINK_FLUSH_INTERVAL_MS.load()), [&] {
+                return !s.running || s.queue.size() >= LoopMonitorConfig::SINK_BATCH_SIZE.load();
+            });
+            lk.unlock();
+            LoopMonitor::drainLoopSinks(s);
+            lk.lock();
+        }
+    });
+}
+
+/**
+ * 22. 移除全部输出通道（输出恢复为同步 std::cerr）
+ * 用法：clearLoopSinks();
+ */
+inline void clearLoopSinks() {
+    auto& d = LoopMonitor::LOOP_SINKS;
+    {
+        // 与入队同锁关闭：此后不再有事件入队，停线程时的最后一次分发把已入队的事件都写到原通道
+        std::lock_guard<std::mutex> lock(d.mutex);
+        d.active.store(false, std::memory_order_release);
+    }
+    LoopMonitor::stopLoopSinkThread(d);
+    std::lock_guard<std::mutex> lock(d.mutex);
+    d.sinks.clear();
+}
+
+/**
+ * 23. 立即分发队列中的事件（退出前/测试断言前调用）
+ * 用法：flushLoopSinks();
+ */
+inline void flushLoopSinks() {
+    LoopMonitor::drainLoopSinks(LoopMonitor::LOOP_SINKS);
+}
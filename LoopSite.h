@@ -0,0 +1,355 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <iterator>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "LoopNameHash.h"
+#include "LoopNuma.h"
+
+// 循环站点（每个监控点一个静态描述符，统计按站点聚合）
+namespace LoopMonitor {
+
+// 站点表容量：超出后站点仍可用，但不进入全局遍历（id 为 0）
+inline constexpr uint32_t kMaxLoopSites = 4096;
+// 站点默认采样率：未调用 setLoopSampleRate 的站点每 64 次校验完整记录一次（阈值比较与超标计数仍每次执行）
+inline constexpr uint32_t kDefaultLoopSampleRate = 64;
+
+inline uint64_t monotonicNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// 无锁取最大值（relaxed 即可，统计允许短暂不一致）
+inline void atomicMaxRelaxed(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t cur = target.load(std::memory_order_relaxed);
+    while (value > cur &&
+           !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+    }
+}
+
+// N 的分布直方图：每个 2 的幂区间再切 4 段（相对误差 < 25%），固定 256 桶
+struct LoopSizeHistogram {
+    static constexpr int kBuckets = 256;
+    std::atomic<uint64_t> counts[kBuckets]{};
+
+    static constexpr int bucketOf(uint64_t n) {
+        if (n < 4) return static_cast<int>(n);
+        const int e = 63 - std::countl_zero(n);
+        return (e - 1) * 4 + static_cast<int>((n >> (e - 2)) & 3);
+    }
+
+    // 桶内最大值（分位数按上界估计，偏保守）
+    static constexpr uint64_t bucketUpper(int idx) {
+        if (idx < 4) return static_cast<uint64_t>(idx);
+        const int e = idx / 4 + 1;
+        const uint64_t lower = (4ull + static_cast<uint64_t>(idx % 4)) << (e - 2);
+        return lower + ((1ull << (e - 2)) - 1);
+    }
+
+    void record(uint64_t n, uint64_t weight = 1) {
+        counts[bucketOf(n)].fetch_add(weight, std::memory_order_relaxed);
+    }
+};
+
+// 站点统计（热路径只做 relaxed 原子累加，读取时汇总为快照）
+struct alignas(64) LoopSiteStats {
+    std::atomic<uint64_t> invocations{0};   // 校验次数（按采样率放大后的估计值）
+    std::atomic<uint64_t> samples{0};       // 实际采样次数
+    std::atomic<uint64_t> iterations{0};    // 累计 N
+    std::atomic<uint64_t> maxN{0};          // 观测到的最大 N
+    std::atomic<uint64_t> violations{0};    // 超标次数
+    std::atomic<uint64_t> timedInvocations{0};
+    std::atomic<uint64_t> totalNs{0};       // 守卫计时累计耗时
+    // 硬件/软件性能计数增量（仅开启 ENABLE_PERF_COUNTERS 时累加）
+    std::atomic<uint64_t> perfSamples{0};
+    std::atomic<uint64_t> instructions{0};
+    std::atomic<uint64_t> cycles{0};
+    std::atomic<uint64_t> llcMisses{0};
+    std::atomic<uint64_t> branchMisses{0};
+    std::atomic<uint64_t> cpuNs{0};
+    // 循环体内的堆分配（仅链接 LoopAllocHooks.cpp 时累加，嵌套守卫只记在最内层）
+    std::atomic<uint64_t> allocGuards{0};       // 参与分配统计的守卫次数
+    std::atomic<uint64_t> allocIterations{0};   // 这些守卫覆盖的 N 之和
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocBytes{0};
+    // 按学习到的每次迭代耗时预测超出时间预算的次数（见 LoopTimePrediction.h）
+    std::atomic<uint64_t> predictedOverruns{0};
+    // 截断模式下 N 超过站点上限、只执行前 cap 项的次数，及被跳过的迭代数之和
+    std::atomic<uint64_t> truncations{0};
+    std::atomic<uint64_t> truncatedIterations{0};
+    LoopSizeHistogram histogram;
+};
+
+// 统计快照（普通整数，供打印/导出使用）
+struct LoopSiteSnapshot {
+    uint64_t invocations = 0;
+    uint64_t samples = 0;
+    uint64_t iterations = 0;
+    uint64_t maxN = 0;
+    uint64_t violations = 0;
+    uint64_t timedInvocations = 0;
+    uint64_t totalNs = 0;
+    uint64_t perfSamples = 0;
+    uint64_t instructions = 0;
+    uint64_t cycles = 0;
+    uint64_t llcMisses = 0;
+    uint64_t branchMisses = 0;
+    uint64_t cpuNs = 0;
+    uint64_t allocGuards = 0;
+    uint64_t allocIterations = 0;
+    uint64_t allocations = 0;
+    uint64_t allocBytes = 0;
+    uint64_t predictedOverruns = 0;
+    uint64_t truncations = 0;
+    uint64_t truncatedIterations = 0;
+};
+
+struct LoopSite;
+
+// 按站点名哈希预置的配置（站点可能尚未执行，登记时再应用；0 表示不覆盖，UINT64_MAX 表示清除为 0）
+struct LoopSiteOverride {
+    uint32_t sampleRate = 0;
+    uint64_t timeBudgetNs = 0;
+    uint64_t clampLimit = 0;
+};
+
+struct LoopSiteOverrideStore {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, LoopSiteOverride> byHash;
+    std::atomic<bool> any{false};
+};
+
+inline LoopSiteOverrideStore& loopSiteOverrides() {
+    static LoopSiteOverrideStore store;
+    return store;
+}
+
+// 站点登记时查询的预置阈值（见 LoopProfile.h；返回 0 表示无预置）
+using LoopThresholdPresetFn = uint64_t (*)(uint64_t nameHash);
+inline std::atomic<LoopThresholdPresetFn> LOOP_THRESHOLD_PRESET{nullptr};
+
+// 站点登记时取回重启前的持久状态（见 LoopPersistentState.h）
+using LoopSiteRestoreFn = void (*)(LoopSite&);
+inline std::atomic<LoopSiteRestoreFn> LOOP_SITE_RESTORE{nullptr};
+
+// 全局站点表：id 从 1 开始，0 表示未登记
+struct LoopSiteRegistry {
+    std::atomic<LoopSite*> sites[kMaxLoopSites + 1]{};
+    std::atomic<uint32_t> nextId{1};
+};
+
+inline LoopSiteRegistry LOOP_SITE_REGISTRY;
+
+// 告警轮次：站点记下最近一次告警所在的轮次，轮次加一即重新武装所有站点（不遍历站点）
+inline std::atomic<uint64_t> LOOP_WARN_EPOCH{1};
+
+struct LoopSite {
+    const char* name;   // 需为字符串字面量（生命周期覆盖整个进程），仅用于输出
+    uint64_t nameHash;  // 站点身份：同名站点哈希相同
+    uint32_t id = 0;
+    // 站点级阈值：0 表示沿用全局 LOOP_WARN_THRESHOLD
+    std::atomic<uint64_t> threshold{0};
+    // 采样率：每 sampleRate 次调用完整记录一次（1 表示全量）
+    std::atomic<uint32_t> sampleRate{kDefaultLoopSampleRate};
+    // 每次迭代耗时（纳秒，Q16 定点），由计时守卫学习；0 表示尚未学习
+    std::atomic<uint64_t> nsPerIterQ16{0};
+    // 站点级时间预算：0 表示沿用全局 LOOP_TIME_BUDGET_NS
+    std::atomic<uint64_t> timeBudgetNs{0};
+    // 截断上限：LOOP_CHECKED_SIZE / 有界下标 / 分片循环只执行前 clampLimit 项；0 与 UINT64_MAX 表示不截断
+    std::atomic<uint64_t> clampLimit{0};
+    // 自适应学习状态（见 LoopAdaptiveThreshold.h）
+    std::atomic<uint8_t> adaptiveState{0};
+    // 最近一次超标告警所在的轮次（0 表示从未告警，见 LOOP_WARN_EPOCH）
+    std::atomic<uint64_t> warnedEpoch{0};
+    // 最近一次截断提示所在的轮次（与超标告警分开认领，截断提示不占用超标告警）
+    std::atomic<uint64_t> clampNoticeEpoch{0};
+    // 循环体分配告警是否已发出（每站点一次）
+    std::atomic<bool> allocAlerted{false};
+    // 持久状态是否已取回（取回前不写回，避免新进程的零值覆盖快照）
+    std::atomic<bool> persistRestored{false};
+    LoopSiteStats stats;   // 节点 0（及未分片时所有线程）的统计
+    // 其他 NUMA 节点的统计分片（下标为节点号，0 不用），读取时经 snapshotLoopSite 汇总
+    std::atomic<LoopSiteStats*> nodeStats[kMaxLoopNodes]{};
+
+    explicit LoopSite(const char* loopName) : LoopSite(loopName, loopNameHash(loopName)) {}
+
+    LoopSite(const char* loopName, uint64_t hash) : name(loopName), nameHash(hash) {
+        uint32_t newId = LOOP_SITE_REGISTRY.nextId.fetch_add(1, std::memory_order_relaxed);
+        if (newId <= kMaxLoopSites) {
+            id = newId;
+            LOOP_SITE_REGISTRY.sites[newId].store(this, std::memory_order_seq_cst);
+        }
+        // 剖析文件给出的阈值优先级最低，按名预置配置可再覆盖
+        if (LoopThresholdPresetFn preset = LOOP_THRESHOLD_PRESET.load(std::memory_order_seq_cst)) {
+            if (const uint64_t t = preset(nameHash)) threshold.store(t, std::memory_order_relaxed);
+        }
+        // 先登记再查预置配置：与 updateLoopSiteOverride 并发时至少一方能看到对方
+        auto& overrides = loopSiteOverrides();
+        if (overrides.any.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(overrides.mutex);
+            auto it = overrides.byHash.find(nameHash);
+            if (it != overrides.byHash.end()) applyOverride(it->second);
+        }
+        if (LoopSiteRestoreFn restore = LOOP_SITE_RESTORE.load(std::memory_order_seq_cst)) restore(*this);
+        // 多节点时预建各节点分片，热路径的 localStats() 只读指针（节点数也在此首次探测，不落在热路径上）
+        const uint32_t nodes = loopNumaNodes();
+        if (nodes > 1 && LoopMonitorConfig::ENABLE_NUMA_SHARDING.load(std::memory_order_relaxed)) {
+            for (uint32_t node = 1; node < nodes; ++node) createOnLoopNode(node, nodeStats[node]);
+        }
+    }
+
+    void applyOverride(const LoopSiteOverride& o) {
+        if (o.sampleRate) sampleRate.store(o.sampleRate, std::memory_order_relaxed);
+        if (o.timeBudgetNs) timeBudgetNs.store(o.timeBudgetNs == UINT64_MAX ? 0 : o.timeBudgetNs, std::memory_order_relaxed);
+        if (o.clampLimit) clampLimit.store(o.clampLimit, std::memory_order_relaxed);
+    }
+
+    LoopSite(const LoopSite&) = delete;
+    LoopSite& operator=(const LoopSite&) = delete;
+
+    // 热路径写入入口：写本线程所在节点的分片（单节点时恒为 stats；
+    // 分片未预建（登记时未开启分片或内存不足）时也写 stats），不加锁、不分配
+    LoopSiteStats& localStats() {
+        const uint32_t node = currentLoopNode();
+        if (node == 0) return stats;
+        LoopSiteStats* shard = nodeStats[node].load(std::memory_order_acquire);
+        return shard ? *shard : stats;
+    }
+
+    // 依次访问各分片（读取方用）
+    template <typename Fn>
+    void forEachStatsShard(Fn&& fn) const {
+        fn(stats);
+        for (uint32_t node = 1; node < kMaxLoopNodes; ++node) {
+            if (const LoopSiteStats* shard = nodeStats[node].load(std::memory_order_acquire)) fn(*shard);
+        }
+    }
+};
+
+// 汇总站点统计
+inline LoopSiteSnapshot snapshotLoopSite(const LoopSite& site) {
+    constexpr auto r = std::memory_order_relaxed;
+    LoopSiteSnapshot snap;
+    site.forEachStatsShard([&](const LoopSiteStats& s) {
+        snap.invocations += s.invocations.load(r);
+        snap.samples += s.samples.load(r);
+        snap.iterations += s.iterations.load(r);
+        snap.maxN = std::max(snap.maxN, s.maxN.load(r));
+        snap.violations += s.violations.load(r);
+        snap.timedInvocations += s.timedInvocations.load(r);
+        snap.totalNs += s.totalNs.load(r);
+        snap.perfSamples += s.perfSamples.load(r);
+        snap.instructions += s.instructions.load(r);
+        snap.cycles += s.cycles.load(r);
+        snap.llcMisses += s.llcMisses.load(r);
+        snap.branchMisses += s.branchMisses.load(r);
+        snap.cpuNs += s.cpuNs.load(r);
+        snap.allocGuards += s.allocGuards.load(r);
+        snap.allocIterations += s.allocIterations.load(r);
+        snap.allocations += s.allocations.load(r);
+        snap.allocBytes += s.allocBytes.load(r);
+        snap.predictedOverruns += s.predictedOverruns.load(r);
+        snap.truncations += s.truncations.load(r);
+        snap.truncatedIterations += s.truncatedIterations.load(r);
+    });
+    return snap;
+}
+
+// 汇总站点 N 分布，返回样本总数
+inline uint64_t snapshotLoopHistogram(const LoopSite& site, uint64_t (&out)[LoopSizeHistogram::kBuckets]) {
+    uint64_t total = 0;
+    std::fill(std::begin(out), std::end(out), 0);
+    site.forEachStatsShard([&](const LoopSiteStats& s) {
+        for (int i = 0; i < LoopSizeHistogram::kBuckets; ++i) {
+            const uint64_t c = s.histogram.counts[i].load(std::memory_order_relaxed);
+            out[i] += c;
+            total += c;
+        }
+    });
+    return total;
+}
+
+// 由直方图估计分位数（q 取 0~1）
+inline uint64_t histogramQuantile(const uint64_t (&counts)[LoopSizeHistogram::kBuckets],
+                                  uint64_t total, double q) {
+    if (total == 0) return 0;
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(total));
+    if (rank >= total) rank = total - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LoopSizeHistogram::kBuckets; ++i) {
+        seen += counts[i];
+        if (seen > rank) return LoopSizeHistogram::bucketUpper(i);
+    }
+    return LoopSizeHistogram::bucketUpper(LoopSizeHistogram::kBuckets - 1);
+}
+
+// 按 id 查站点（未登记返回 nullptr）
+inline LoopSite* findLoopSiteById(uint32_t id) {
+    if (id == 0 || id > kMaxLoopSites) return nullptr;
+    return LOOP_SITE_REGISTRY.sites[id].load(std::memory_order_acquire);
+}
+
+// 按名字哈希反查站点（输出/配置用，线性扫描；未登记返回 nullptr）
+inline LoopSite* findLoopSiteByHash(uint64_t hash) {
+    uint32_t end = LOOP_SITE_REGISTRY.nextId.load(std::memory_order_acquire);
+    if (end > kMaxLoopSites + 1) end = kMaxLoopSites + 1;
+    for (uint32_t id = 1; id < end; ++id) {
+        LoopSite* site = LOOP_SITE_REGISTRY.sites[id].load(std::memory_order_acquire);
+        if (site && site->nameHash == hash) return site;
+    }
+    return nullptr;
+}
+
+// 遍历已登记站点（按 id 顺序）
+template <typename Fn>
+void forEachLoopSite(Fn&& fn) {
+    uint32_t end = LOOP_SITE_REGISTRY.nextId.load(std::memory_order_acquire);
+    if (end > kMaxLoopSites + 1) end = kMaxLoopSites + 1;
+    for (uint32_t id = 1; id < end; ++id) {
+        LoopSite* site = LOOP_SITE_REGISTRY.sites[id].load(std::memory_order_acquire);
+        if (site) fn(*site);
+    }
+}
+
+// 修改按名预置配置，并同步到已登记的同名站点
+template <typename Fn>
+void updateLoopSiteOverride(const char* loopName, Fn&& fn) {
+    const uint64_t hash = loopNameHash(loopName);
+    auto& overrides = loopSiteOverrides();
+    LoopSiteOverride o;
+    {
+        std::lock_guard<std::mutex> lock(overrides.mutex);
+        LoopSiteOverride& entry = overrides.byHash[hash];
+        fn(entry);
+        o = entry;
+        overrides.any.store(true, std::memory_order_seq_cst);
+    }
+    forEachLoopSite([&](LoopSite& site) {
+        if (site.nameHash == hash) site.applyOverride(o);
+    });
+}
+
+// 同名站点共用一个描述符：名字在编译期折叠为哈希，模板实例即站点
+template <FixedString Name>
+LoopSite& siteFor() {
+    static LoopSite site(Name.data, kLoopNameHash<Name>);
+    return site;
+}
+
+} // namespace LoopMonitor
+
+// 站点获取函数（调用时才构造站点，负数等非法 N 只在报告时才触碰站点）
+// LOOP_NAME 需为字符串字面量；同名的多个展开点共用一个站点
+#define LOOP_MONITOR_SITE_FN(LOOP_NAME) \
+    ([]() -> LoopMonitor::LoopSite& { return LoopMonitor::siteFor<LOOP_NAME>(); })
+
+// 取站点（同名展开点共用）
+#define LOOP_MONITOR_SITE(LOOP_NAME) (LOOP_MONITOR_SITE_FN(LOOP_NAME)())
+
+#define LOOP_MONITOR_CONCAT_IMPL(A, B) A##B
+#define LOOP_MONITOR_CONCAT(A, B) LOOP_MONITOR_CONCAT_IMPL(A, B)
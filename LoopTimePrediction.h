@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "LoopSite.h"
+#include "LoopSink.h"
+
+// 耗时预测：计时守卫按站点学习每次迭代的耗时（Q16 定点纳秒，指数滑动平均），
+// 循环开始前用 N × 单次耗时 与时间预算比较，预计超时的循环在消耗 CPU 之前就告警/熔断
+namespace LoopMonitorConfig {
+    // 全局时间预算（纳秒）：0 表示不做耗时预测
+    inline std::atomic<uint64_t> LOOP_TIME_BUDGET_NS = 0;
+}
+
+namespace LoopMonitor {
+
+// 少于该迭代数的计时不参与学习（固定开销占比过大）
+inline constexpr uint64_t kLoopCostMinIterations = 64;
+// 滑动平均权重 1/2^kLoopCostEwmaShift
+inline constexpr int kLoopCostEwmaShift = 3;
+
+inline uint64_t effectiveLoopTimeBudget(const LoopSite& site) {
+    const uint64_t siteBudget = site.timeBudgetNs.load(std::memory_order_relaxed);
+    return siteBudget ? siteBudget : LoopMonitorConfig::LOOP_TIME_BUDGET_NS.load(std::memory_order_relaxed);
+}
+
+// 热路径：一次 64×64→128 乘法与比较；未设预算或尚未学习（耗时为 0）时恒为 false
+inline bool loopPredictedOverBudget(const LoopSite& site, uint64_t loopSize, uint64_t budgetNs) {
+    const uint64_t costQ16 = site.nsPerIterQ16.load(std::memory_order_relaxed);
+    return static_cast<unsigned __int128>(loopSize) * costQ16 > static_cast<unsigned __int128>(budgetNs) << 16;
+}
+
+// 预算内可执行的迭代数（告警输出用）
+inline uint64_t loopPredictedIterationLimit(const LoopSite& site, uint64_t budgetNs) {
+    const uint64_t costQ16 = site.nsPerIterQ16.load(std::memory_order_relaxed);
+    if (costQ16 == 0) return UINT64_MAX;
+    const unsigned __int128 limit = (static_cast<unsigned __int128>(budgetNs) << 16) / costQ16;
+    return limit > UINT64_MAX ? UINT64_MAX : static_cast<uint64_t>(limit);
+}
+
+// 守卫退出时学习（多线程并发写只会丢几次更新，不影响估计）
+inline void learnLoopIterationCost(LoopSite& site, uint64_t loopSize, uint64_t elapsedNs) {
+    if (loopSize < kLoopCostMinIterations) return;
+    const unsigned __int128 q = (static_cast<unsigned __int128>(elapsedNs) << 16) / loopSize;
+    const uint64_t sample = q > UINT64_MAX ? UINT64_MAX : static_cast<uint64_t>(q);
+    const uint64_t old = site.nsPerIterQ16.load(std::memory_order_relaxed);
+    const uint64_t next = old == 0 ? sample
+        : old - (old >> kLoopCostEwmaShift) + (sample >> kLoopCostEwmaShift);
+    site.nsPerIterQ16.store(next ? next : 1, std::memory_order_relaxed);
+}
+
+} // namespace LoopMonitor
+
+/**
+ * 29. 全局时间预算（按学习到的单次迭代耗时预测整段循环耗时）
+ * 用法：setLoopTimeBudget(200); // 预计超过 200ms 的循环在开始前即按超标处理（告警，开启熔断时跳过）
+ * 说明：单次迭代耗时由 LOOP_MONITOR_GUARD 的计时学习（迭代数 ≥ 64 的调用），
+ *       同名的 CHECK_LOOP_DYNAMIC_SIZE / LOOP_CHECKED_SIZE / 有界下标共用该站点的学习结果；传 0 关闭
+ */
+inline void setLoopTimeBudget(uint64_t budgetMs) {
+    LoopMonitorConfig::LOOP_TIME_BUDGET_NS.store(budgetMs * 1000000);
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config) << "[LOOP_CONFIG] 时间预算: " << budgetMs << "ms";
+}
+
+/**
+ * 30. 站点时间预算（覆盖全局预算；站点尚未执行时先记录）
+ * 用法：setLoopSiteTimeBudget("业务-数据同步循环", 50);
+ * 说明：传 0 清除站点预算，恢复使用全局预算
+ */
+inline void setLoopSiteTimeBudget(const char* loopName, uint64_t budgetMs) {
+    // 按名预置配置以 0 表示未设置，清除记为 UINT64_MAX（applyOverride 还原为 0）
+    LoopMonitor::updateLoopSiteOverride(loopName, [&](LoopMonitor::LoopSiteOverride& o) {
+        o.timeBudgetNs = budgetMs ? budgetMs * 1000000 : UINT64_MAX;
+    });
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config)
+        << "[LOOP_CONFIG] 站点时间预算: " << loopName << " = " << budgetMs << "ms";
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "LoopSite.h"
+#include "LoopSink.h"
+
+// 循环时间线：守卫进入/退出各读一次 TSC，退出时向本线程的环形缓冲追加一条跨度（站点、线程、N、起止），
+// 导出时按最近的时间窗口写成 Chrome trace event JSON（chrome://tracing 与 Perfetto UI 均可直接打开）
+namespace LoopMonitorConfig {
+    // 是否记录循环跨度（setLoopTrace 开关）
+    inline std::atomic<bool> ENABLE_LOOP_TRACE = false;
+}
+
+namespace LoopMonitor {
+
+inline constexpr int kLoopTraceThreads = 64;
+inline constexpr uint64_t kLoopTraceRingSpans = 16384;   // 2 的幂，每线程 512KB，首次记录时分配
+
+struct LoopTraceSpan {
+    uint64_t beginTicks;
+    uint64_t endTicks;
+    uint64_t loopSize;
+    uint32_t siteId;
+    uint32_t tid;
+};
+
+// 单写者（所属线程）覆盖写；导出方读取前后各取一次 head，丢弃期间可能被覆盖的条目
+struct alignas(64) LoopTraceRing {
+    std::atomic<bool> inUse{false};
+    std::atomic<uint64_t> head{0};
+    std::unique_ptr<LoopTraceSpan[]> spans;
+};
+
+struct LoopTraceState {
+    LoopTraceRing rings[kLoopTraceThreads];
+    std::atomic<uint64_t> droppedSpans{0};   // 环已用尽的线程丢弃的跨度
+    // TSC 与单调时钟的换算基准（开启记录时取）
+    uint64_t baseTicks = 0;
+    uint64_t baseNs = 0;
+    std::mutex mutex;
+};
+
+inline LoopTraceState LOOP_TRACE;
+inline thread_local LoopTraceRing* LOOP_TRACE_RING = nullptr;
+inline thread_local uint32_t LOOP_TRACE_TID = 0;
+
+inline uint64_t loopTraceTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return monotonicNs();
+#endif
+}
+
+// 线程退出时归还环（已记录的跨度保留到被新线程覆盖为止）
+struct LoopTraceRelease {
+    ~LoopTraceRelease() {
+        if (LoopTraceRing* ring = LOOP_TRACE_RING) ring->inUse.store(false, std::memory_order_release);
+        LOOP_TRACE_RING = nullptr;
+    }
+};
+
+[[gnu::cold]] [[gnu::noinline]] inline LoopTraceRing* claimLoopTraceRing() {
+    thread_local LoopTraceRelease release;
+    (void)release;
+    for (auto& ring : LOOP_TRACE.rings) {
+        bool expected = false;
+        if (ring.inUse.load(std::memory_order_relaxed) ||
+            !ring.inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            continue;
+        }
+        if (!ring.spans) {
+            std::lock_guard<std::mutex> lock(LOOP_TRACE.mutex);   // 与导出方读取 spans 指针互斥
+            ring.spans = std::make_unique<LoopTraceSpan[]>(kLoopTraceRingSpans);
+        }
+        LOOP_TRACE_TID = static_cast<uint32_t>(syscall(SYS_gettid));
+        LOOP_TRACE_RING = &ring;
+        return &ring;
+    }
+    return nullptr;
+}
+
+// 守卫退出时调用：一次环形缓冲追加
+inline void appendLoopTraceSpan(const LoopSite& site, uint64_t loopSize, uint64_t beginTicks, uint64_t endTicks) {
+    LoopTraceRing* ring = LOOP_TRACE_RING;
+    if (!ring) [[unlikely]] {
+        ring = claimLoopTraceRing();
+        if (!ring) {
+            LOOP_TRACE.droppedSpans.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    const uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->spans[head & (kLoopTraceRingSpans - 1)] = {beginTicks, endTicks, loopSize, site.id, LOOP_TRACE_TID};
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+inline void appendJsonEscaped(std::string& out, const char* s) {
+    for (; *s; ++s) {
+        const auto c = static_cast<unsigned char>(*s);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+}
+
+} // namespace LoopMonitor
+
+/**
+ * 31. 循环跨度记录开关
+ * 用法：setLoopTrace(true); // 之后进入的 LOOP_MONITOR_GUARD 记录起止时刻
+ * 说明：每次循环两次 TSC 读取加一次线程本地环形缓冲追加；每线程保留最近 16384 条，线程数超过 64 时丢弃并计数
+ */
+inline void setLoopTrace(bool enable) {
+    auto& st = LoopMonitor::LOOP_TRACE;
+    if (enable) {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        st.baseTicks = LoopMonitor::loopTraceTicks();
+        st.baseNs = LoopMonitor::monotonicNs();
+    }
+    LoopMonitorConfig::ENABLE_LOOP_TRACE.store(enable);
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config) << "[LOOP_CONFIG] 循环跨度记录: " << (enable ? "开启" : "关闭");
+}
+
+/**
+ * 32. 导出最近一段时间的循环跨度（Chrome trace event JSON）
+ * 用法：writeLoopTrace("/tmp/loops.json", 5000); // 最近 5 秒，chrome://tracing 或 ui.perfetto.dev 打开
+ * 说明：每条跨度为一个 "X" 事件（起点 + 时长），参数带站点 id 与 N；记录不停止，可随时多次导出
+ */
+inline bool writeLoopTrace(const std::string& path, uint64_t windowMs = 10000) {
+    auto& st = LoopMonitor::LOOP_TRACE;
+    std::lock_guard<std::mutex> lock(st.mutex);
+    // 用当前时刻与开启时的基准换算 TSC 频率
+    const uint64_t nowTicks = LoopMonitor::loopTraceTicks();
+    const uint64_t nowNs = LoopMonitor::monotonicNs();
+    const double nsPerTick = nowTicks > st.baseTicks
+        ? static_cast<double>(nowNs - st.baseNs) / static_cast<double>(nowTicks - st.baseTicks) : 1.0;
+    const uint64_t windowTicks = static_cast<uint64_t>(static_cast<double>(windowMs) * 1e6 / nsPerTick);
+    const uint64_t fromTicks = nowTicks > windowTicks ? nowTicks - windowTicks : 0;
+
+    std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    const int pid = static_cast<int>(getpid());
+    bool first = true;
+    uint64_t exported = 0;
+    std::vector<LoopMonitor::LoopTraceSpan> copy;
+    for (auto& ring : st.rings) {
+        if (!ring.spans) continue;
+        const uint64_t headBefore = ring.head.load(std::memory_order_acquire);
+        const uint64_t begin = headBefore > LoopMonitor::kLoopTraceRingSpans
+                                   ? headBefore - LoopMonitor::kLoopTraceRingSpans : 0;
+        copy.clear();
+        for (uint64_t i = begin; i < headBefore; ++i) {
+            copy.push_back(ring.spans[i & (LoopMonitor::kLoopTraceRingSpans - 1)]);
+        }
+        // 复制期间被写者覆盖的条目不可信，丢弃
+        const uint64_t headAfter = ring.head.load(std::memory_order_acquire);
+        const uint64_t firstValid = headAfter > LoopMonitor::kLoopTraceRingSpans
+                                        ? headAfter - LoopMonitor::kLoopTraceRingSpans : 0;
+        for (uint64_t i = begin; i < headBefore; ++i) {
+            const LoopMonitor::LoopTraceSpan& span = copy[i - begin];
+            if (i < firstValid || span.endTicks < fromTicks || span.beginTicks < st.baseTicks) continue;
+            const LoopMonitor::LoopSite* site = LoopMonitor::findLoopSiteById(span.siteId);
+            const double tsUs = static_cast<double>(span.beginTicks - st.baseTicks) * nsPerTick / 1000.0;
+            const double durUs = static_cast<double>(span.endTicks - span.beginTicks) * nsPerTick / 1000.0;
+            char buf[192];
+            json += first ? "\n" : ",\n";
+            first = false;
+            json += "{\"name\":\"";
+            LoopMonitor::appendJsonEscaped(json, site ? site->name : "<unknown>");
+            std::snprintf(buf, sizeof(buf),
+                          "\",\"cat\":\"loop\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u,"
+                          "\"args\":{\"siteId\":%u,\"N\":%llu}}",
+                          tsUs, durUs, pid, span.tid, span.siteId, static_cast<unsigned long long>(span.loopSize));
+            json += buf;
+            ++exported;
+        }
+    }
+    json += "\n]}\n";
+
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    const bool ok = std::fwrite(json.data(), 1, json.size(), f) == json.size();
+    if (std::fclose(f) != 0 || !ok) return false;
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config)
+        << "[LOOP_TRACE] 已导出跨度: " << exported << " -> " << path
+        << " | 丢弃: " << st.droppedSpans.load(std::memory_order_relaxed);
+    return true;
+}
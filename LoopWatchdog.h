@@ -0,0 +1,289 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <execinfo.h>
+#include <mutex>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include "LoopSite.h"
+#include "LoopSink.h"
+
+// 看门狗：后台线程扫描各线程心跳槽，发现卡在循环体/阻塞调用里的循环
+namespace LoopMonitorConfig {
+    // 单次循环的时间预算（毫秒），超出即上报
+    inline std::atomic<uint64_t> WATCHDOG_BUDGET_MS = 1000;
+    // 扫描周期（毫秒）
+    inline std::atomic<uint64_t> WATCHDOG_PERIOD_MS = 100;
+}
+
+namespace LoopMonitor {
+
+inline constexpr int kMaxHeartbeatThreads = 256;
+inline constexpr int kWatchdogStackDepth = 32;
+// 心跳字：高 44 位为进入时刻（毫秒），低 20 位为站点 id；0 表示当前不在监控循环内
+inline constexpr int kHeartbeatSiteBits = 20;
+
+enum WatchdogCapture : uint32_t {
+    kCaptureIdle = 0,
+    kCaptureRequested = 1,
+    kCaptureDone = 2,
+};
+
+struct alignas(64) LoopHeartbeatSlot {
+    std::atomic<uint64_t> active{0};     // 热路径：进入/退出各一次 relaxed store
+    std::atomic<uint64_t> lastTick{0};   // 热路径：循环内计数
+    std::atomic<uint64_t> countBeat{0};  // 计数校验循环：首次计数时进入（格式同 active），看门狗发现计数停止推进时离开
+    std::atomic<bool> inUse{false};
+    std::atomic<pid_t> tid{0};
+    // 以下只由看门狗和信号处理函数访问
+    std::atomic<uint32_t> captureState{kCaptureIdle};
+    int frameCount = 0;
+    void* frames[kWatchdogStackDepth] = {};
+    uint64_t reportedBeat = 0;
+    uint64_t reportedCountBeat = 0;
+    uint64_t scannedTick = 0;            // 上一次扫描时的 lastTick
+};
+
+struct LoopWatchdogState {
+    LoopHeartbeatSlot slots[kMaxHeartbeatThreads];
+    LoopHeartbeatSlot overflowSlot;   // 槽位用尽的线程共用，不参与扫描
+    std::atomic<bool> running{false};
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::thread thread;
+    int signalNo = 0;
+    struct sigaction prevAction {};            // 启动前的信号处理方式，停止时恢复
+    std::atomic<uint32_t> pendingSignals{0};   // 已发出、处理函数尚未执行的抓栈信号
+    ~LoopWatchdogState();
+};
+
+inline LoopWatchdogState LOOP_WATCHDOG;
+inline thread_local LoopHeartbeatSlot* LOOP_HEARTBEAT_SLOT = nullptr;
+
+inline uint64_t makeHeartbeat(uint32_t siteId, uint64_t nowNs) {
+    return ((nowNs / 1000000) << kHeartbeatSiteBits) | (siteId & ((1u << kHeartbeatSiteBits) - 1));
+}
+
+// 线程退出时归还槽位
+struct LoopHeartbeatRelease {
+    ~LoopHeartbeatRelease() {
+        LoopHeartbeatSlot* slot = LOOP_HEARTBEAT_SLOT;
+        if (!slot || slot == &LOOP_WATCHDOG.overflowSlot) return;
+        slot->active.store(0, std::memory_order_relaxed);
+        slot->tid.store(0, std::memory_order_relaxed);
+        slot->inUse.store(false, std::memory_order_release);
+        LOOP_HEARTBEAT_SLOT = nullptr;
+    }
+};
+
+[[gnu::noinline]] inline void claimHeartbeatSlot() {
+    thread_local LoopHeartbeatRelease release;
+    (void)release;
+    for (auto& slot : LOOP_WATCHDOG.slots) {
+        bool expected = false;
+        if (slot.inUse.load(std::memory_order_relaxed) ||
+            !slot.inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            continue;
+        }
+        slot.active.store(0, std::memory_order_relaxed);
+        slot.lastTick.store(0, std::memory_order_relaxed);
+        slot.countBeat.store(0, std::memory_order_relaxed);
+        slot.captureState.store(kCaptureIdle, std::memory_order_relaxed);
+        slot.reportedBeat = 0;
+        slot.reportedCountBeat = 0;
+        slot.scannedTick = 0;
+        slot.tid.store(static_cast<pid_t>(syscall(SYS_gettid)), std::memory_order_release);
+        LOOP_HEARTBEAT_SLOT = &slot;
+        return;
+    }
+    LOOP_HEARTBEAT_SLOT = &LOOP_WATCHDOG.overflowSlot;
+}
+
+inline LoopHeartbeatSlot* loopHeartbeatSlot() {
+    if (!LOOP_HEARTBEAT_SLOT) [[unlikely]] claimHeartbeatSlot();
+    return LOOP_HEARTBEAT_SLOT;
+}
+
+// 循环内计数的心跳（看门狗运行时才写）
+inline void loopHeartbeatTick(uint64_t count) {
+    if (LoopHeartbeatSlot* slot = LOOP_HEARTBEAT_SLOT) slot->lastTick.store(count, std::memory_order_relaxed);
+}
+
+[[gnu::noinline]] inline void enterCountHeartbeat(uint32_t siteId) {
+    loopHeartbeatSlot()->countBeat.store(makeHeartbeat(siteId, monotonicNs()), std::memory_order_relaxed);
+}
+
+// 计数校验循环的心跳：计数为 1（新一轮循环）且看门狗运行时进入心跳槽，之后每次计数只写 lastTick
+// 计数循环没有离开点：看门狗在两次扫描之间看到计数无推进即令其离开
+template <typename SiteFn>
+inline void loopCountHeartbeat(SiteFn&& siteFn, uint64_t count) {
+    if (count == 1 && LOOP_WATCHDOG.running.load(std::memory_order_relaxed)) [[unlikely]] {
+        enterCountHeartbeat(siteFn().id);
+    }
+    loopHeartbeatTick(count);
+}
+
+// 在被卡住的线程上执行：只抓取返回地址，符号化留给看门狗线程
+inline void loopWatchdogSignalHandler(int) {
+    LOOP_WATCHDOG.pendingSignals.fetch_sub(1, std::memory_order_relaxed);
+    LoopHeartbeatSlot* slot = LOOP_HEARTBEAT_SLOT;
+    if (!slot || slot->captureState.load(std::memory_order_acquire) != kCaptureRequested) return;
+    const int savedErrno = errno;
+    slot->frameCount = backtrace(slot->frames, kWatchdogStackDepth);
+    slot->captureState.store(kCaptureDone, std::memory_order_release);
+    errno = savedErrno;
+}
+
+inline void reportStuckLoop(LoopHeartbeatSlot& slot, uint64_t beat, uint64_t nowMs) {
+    const auto siteId = static_cast<uint32_t>(beat & ((1u << kHeartbeatSiteBits) - 1));
+    const uint64_t entryMs = beat >> kHeartbeatSiteBits;
+    const pid_t tid = slot.tid.load(std::memory_order_acquire);
+    const LoopSite* site = findLoopSiteById(siteId);
+
+    // 向目标线程发信号，异步抓栈（最多等 100ms）
+    slot.captureState.store(kCaptureRequested, std::memory_order_release);
+    bool captured = false;
+    LOOP_WATCHDOG.pendingSignals.fetch_add(1, std::memory_order_relaxed);
+    if (syscall(SYS_tgkill, getpid(), tid, LOOP_WATCHDOG.signalNo) != 0) {
+        LOOP_WATCHDOG.pendingSignals.fetch_sub(1, std::memory_order_relaxed);
+    } else {
+        for (int i = 0; i < 100 && !captured; ++i) {
+            captured = slot.captureState.load(std::memory_order_acquire) == kCaptureDone;
+            if (!captured) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    slot.captureState.store(kCaptureIdle, std::memory_order_release);
+
+    loopLog(LoopEventCategory::Watchdog, LoopEventLevel::Error)
+        << "[LOOP_WATCHDOG] LoopName: " << (site ? site->name : "<unknown>")
+        << " | Thread: " << tid << " | Elapsed(ms): " << (nowMs - entryMs)
+        << " | Budget(ms): " << LoopMonitorConfig::WATCHDOG_BUDGET_MS.load()
+        << " | LastTick: " << slot.lastTick.load(std::memory_order_relaxed);
+    if (!captured) {
+        loopLog(LoopEventCategory::Watchdog, LoopEventLevel::Error)
+            << "[LOOP_WATCHDOG] 栈抓取超时（线程可能阻塞在屏蔽信号的调用中）";
+        return;
+    }
+    char** funcNames = backtrace_symbols(slot.frames, slot.frameCount);
+    if (!funcNames) return;
+    {
+        auto out = loopLog(LoopEventCategory::StackTrace, LoopEventLevel::Error);
+        out << "\n===== LOOP WATCHDOG STACK TRACE =====\n";
+        for (int i = 0; i < slot.frameCount; ++i) {
+            out << "[" << i << "] " << funcNames[i] << "\n";
+        }
+        out << "=====================================\n";
+    }
+    free(funcNames);
+}
+
+inline void loopWatchdogScan() {
+    const uint64_t nowMs = monotonicNs() / 1000000;
+    const uint64_t budgetMs = LoopMonitorConfig::WATCHDOG_BUDGET_MS.load(std::memory_order_relaxed);
+    for (auto& slot : LOOP_WATCHDOG.slots) {
+        if (!slot.inUse.load(std::memory_order_acquire)) continue;
+        const uint64_t beat = slot.active.load(std::memory_order_relaxed);
+        if (beat == 0 || beat == slot.reportedBeat) continue;
+        const uint64_t entryMs = beat >> kHeartbeatSiteBits;
+        if (nowMs > entryMs && nowMs - entryMs > budgetMs) {
+            slot.reportedBeat = beat;   // 同一次进入只报一次
+            reportStuckLoop(slot, beat, nowMs);
+        }
+    }
+    // 计数校验循环：计数仍在推进且自首次计数起超过预算即上报；两次扫描之间无推进视为已离开
+    for (auto& slot : LOOP_WATCHDOG.slots) {
+        if (!slot.inUse.load(std::memory_order_acquire)) continue;
+        uint64_t beat = slot.countBeat.load(std::memory_order_relaxed);
+        const uint64_t tick = slot.lastTick.load(std::memory_order_relaxed);
+        const bool progressed = tick != slot.scannedTick;
+        slot.scannedTick = tick;
+        if (beat == 0) continue;
+        if (!progressed) {
+            // 只清除本次看到的进入；期间开始的新一轮循环不受影响
+            slot.countBeat.compare_exchange_strong(beat, 0, std::memory_order_relaxed);
+            continue;
+        }
+        const uint64_t entryMs = beat >> kHeartbeatSiteBits;
+        if (beat != slot.reportedCountBeat && nowMs > entryMs && nowMs - entryMs > budgetMs) {
+            slot.reportedCountBeat = beat;
+            reportStuckLoop(slot, beat, nowMs);
+        }
+    }
+}
+
+// 停止扫描线程并等待其退出，恢复启动前的信号处理方式（stopLoopWatchdog 与进程退出共用）
+inline void stopLoopWatchdogThread(LoopWatchdogState& wd) {
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(wd.mutex);
+        if (!wd.running.load()) return;
+        wd.running.store(false);
+        t = std::move(wd.thread);
+    }
+    wd.wakeup.notify_all();
+    if (t.joinable()) t.join();
+    // 仍有未送达的抓栈信号（目标线程屏蔽了信号）时保留处理函数：此时恢复默认处理会在送达时终止进程，
+    // 而本处理函数对过期信号只是直接返回
+    if (wd.pendingSignals.load(std::memory_order_relaxed) == 0) sigaction(wd.signalNo, &wd.prevAction, nullptr);
+}
+
+// 从 main 返回时线程仍在运行则在此汇合，否则 std::thread 析构会 terminate
+inline LoopWatchdogState::~LoopWatchdogState() {
+    stopLoopWatchdogThread(*this);
+}
+
+} // namespace LoopMonitor
+
+/**
+ * 11. 启动看门狗（发现卡在循环体内、到不了下一次计数校验的循环）
+ * 用法：startLoopWatchdog(2000); // 单次循环超过 2s 即上报站点、线程与栈
+ * 说明：覆盖 LOOP_MONITOR_GUARD 守卫的循环、分片循环，以及 LOOP_DYNAMIC_COUNT_CHECK 计数的循环（首次计数起运行超过预算即上报）；
+ *       计数循环没有离开点，两次扫描之间计数不再推进即视为已结束，卡在循环体内不再计数的情况只有守卫能发现；
+ *       栈通过向目标线程发 SIGRTMIN+3 异步抓取，停止时恢复该信号原来的处理方式
+ */
+inline void startLoopWatchdog(uint64_t budgetMs = 1000, uint64_t periodMs = 100) {
+    auto& wd = LoopMonitor::LOOP_WATCHDOG;
+    std::lock_guard<std::mutex> lock(wd.mutex);
+    if (wd.running.load()) return;
+    LoopMonitorConfig::WATCHDOG_BUDGET_MS.store(budgetMs);
+    LoopMonitorConfig::WATCHDOG_PERIOD_MS.store(periodMs);
+
+    // 预热 backtrace：首次调用会加载 libgcc，不能发生在信号处理函数里
+    void* warmup[1];
+    backtrace(warmup, 1);
+    wd.signalNo = SIGRTMIN + 3;
+    struct sigaction sa {};
+    sa.sa_handler = LoopMonitor::loopWatchdogSignalHandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(wd.signalNo, &sa, &wd.prevAction);
+
+    wd.running.store(true);
+    wd.thread = std::thread([] {
+        auto& w = LoopMonitor::LOOP_WATCHDOG;
+        std::unique_lock<std::mutex> lk(w.mutex);
+        while (w.running.load()) {
+            w.wakeup.wait_for(lk, std::chrono::milliseconds(LoopMonitorConfig::WATCHDOG_PERIOD_MS.load()));
+            if (!w.running.load()) break;
+            lk.unlock();
+            LoopMonitor::loopWatchdogScan();
+            lk.lock();
+        }
+    });
+    LoopMonitor::loopLog(LoopMonitor::LoopEventCategory::Config) << "[LOOP_CONFIG] 看门狗已启动 | 预算(ms): " << budgetMs;
+}
+
+/**
+ * 12. 停止看门狗
+ * 用法：stopLoopWatchdog();
+ * 说明：未调用时进程退出（main 返回或 exit）会自动停止
+ */
+inline void stopLoopWatchdog() {
+    LoopMonitor::stopLoopWatchdogThread(LoopMonitor::LOOP_WATCHDOG);
+}
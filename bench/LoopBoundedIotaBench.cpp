@@ -0,0 +1,61 @@
+// 有界下标基准：同一个可向量化的循环体，对比手写循环、int 下标（改造前 main.cpp 的写法）、
+// LOOP_FOR_BOUNDED_INDEX（32/64 位分派）与 LOOP_BOUNDED_IOTA 的每元素耗时
+// 用法：loop-bench-iota [元素数] [重复次数]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "DynamicLoopCheck.h"
+
+namespace {
+
+[[gnu::noinline]] void handwritten(const float* in, float* out, uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) out[i] = in[i] * 2.0f + 1.0f;
+}
+
+// 改造前：int 下标与 uint64_t N 混比（超过 2^31 即溢出，比较前需符号扩展）
+[[gnu::noinline]] void signedIndex(const float* in, float* out, uint64_t n) {
+    for (int i = 0; i < static_cast<int64_t>(n); i++) out[i] = in[i] * 2.0f + 1.0f;
+}
+
+[[gnu::noinline]] void boundedIndex(const float* in, float* out, uint64_t n) {
+    LOOP_FOR_BOUNDED_INDEX(n, "bench-iota-index", [&](auto i) { out[i] = in[i] * 2.0f + 1.0f; });
+}
+
+[[gnu::noinline]] void boundedIota(const float* in, float* out, uint64_t n) {
+    for (uint64_t i : LOOP_BOUNDED_IOTA(n, "bench-iota-range")) out[i] = in[i] * 2.0f + 1.0f;
+}
+
+template <typename Fn>
+double nsPerElement(Fn fn, const std::vector<float>& in, std::vector<float>& out, uint64_t reps) {
+    double best = 1e300;
+    for (uint64_t r = 0; r < reps; ++r) {
+        const auto start = std::chrono::steady_clock::now();
+        fn(in.data(), out.data(), in.size());
+        const auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, ns);
+    }
+    return best / static_cast<double>(in.size());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint64_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (1u << 20);
+    const uint64_t reps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200;
+    std::vector<float> in(n, 1.5f);
+    std::vector<float> out(n);
+    // 全量记录、不告警：计时只包含每次调用一次的校验与完整记录
+    setLoopWarnThreshold(UINT64_MAX);
+    setLoopSampleRate("bench-iota-index", 1);
+    setLoopSampleRate("bench-iota-range", 1);
+
+    std::printf("n=%llu reps=%llu (best of)\n", static_cast<unsigned long long>(n),
+                static_cast<unsigned long long>(reps));
+    std::printf("handwritten uint64_t:    %.4f ns/elem\n", nsPerElement(handwritten, in, out, reps));
+    std::printf("int index (before):      %.4f ns/elem\n", nsPerElement(signedIndex, in, out, reps));
+    std::printf("LOOP_FOR_BOUNDED_INDEX:  %.4f ns/elem\n", nsPerElement(boundedIndex, in, out, reps));
+    std::printf("LOOP_BOUNDED_IOTA:       %.4f ns/elem\n", nsPerElement(boundedIota, in, out, reps));
+    return out[n / 2] == 4.0f ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+// NUMA 分片争用基准：多线程同时校验同一个站点（每次都完整记录），对比分片与不分片的每次校验耗时
+// 用法：loop-bench-numa [线程数] [每线程校验次数]
+// 说明：单节点机器上两组相同（分片只在多节点时生效）；线程按 CPU 顺序绑核，跨插槽的线程才会落到不同节点
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <vector>
+#include "DynamicLoopCheck.h"
+
+namespace {
+
+template <typename SiteFn>
+double runContended(SiteFn siteFn, unsigned threads, uint64_t checks) {
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    const unsigned cpus = std::thread::hardware_concurrency();
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(t % (cpus ? cpus : 1), &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            volatile uint64_t n = 1000;
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {}
+            LoopMonitor::LoopSite& site = siteFn();
+            for (uint64_t i = 0; i < checks; ++i) LoopMonitor::checkLoopSize(site, n);
+        });
+    }
+    while (ready.load() != threads) {}
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& w : workers) w.join();
+    const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsed / static_cast<double>(checks);   // 每线程每次校验的墙钟耗时
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const unsigned threads = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1]))
+                                      : std::max(1u, std::thread::hardware_concurrency());
+    const uint64_t checks = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+    std::printf("nodes=%u threads=%u checks/thread=%llu\n", LoopMonitor::loopNumaNodes(), threads,
+                static_cast<unsigned long long>(checks));
+
+    // 分片开关对之后登记的站点生效：两个站点分别在开关两种状态下登记
+    LoopMonitorConfig::ENABLE_NUMA_SHARDING.store(false);
+    (void)LOOP_MONITOR_SITE("bench-numa-unsharded");
+    LoopMonitorConfig::ENABLE_NUMA_SHARDING.store(true);
+    (void)LOOP_MONITOR_SITE("bench-numa-sharded");
+    setLoopSampleRate("bench-numa-unsharded", 1);
+    setLoopSampleRate("bench-numa-sharded", 1);
+
+    const double unsharded = runContended(LOOP_MONITOR_SITE_FN("bench-numa-unsharded"), threads, checks);
+    const double sharded = runContended(LOOP_MONITOR_SITE_FN("bench-numa-sharded"), threads, checks);
+    std::printf("unsharded: %8.2f ns/check\nsharded:   %8.2f ns/check\n", unsharded, sharded);
+    return 0;
+}
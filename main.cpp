@@ -3,12 +3,22 @@
 uint64_t getDynamicN() { return 700000000; }
 
 int main() {
+    // 演示用全量记录（默认每 64 次校验完整记录一次，统计为按采样率放大的估计值）
+    setLoopSampleRate("业务-数据同步循环", 1);
+    setLoopSampleRate("业务-批量推送循环", 1);
     auto N = getDynamicN();
-    // 循环前校验，7亿次直接告警+打栈
-    CHECK_LOOP_DYNAMIC_SIZE(N, "业务-数据同步循环");
-
-    for(int i=0; i<N; i++){
+    // 循环前校验，7亿次直接告警+打栈；下标与 N 同为 uint64_t，不会溢出/符号扩展
+    for (uint64_t i : LOOP_BOUNDED_IOTA(N, "业务-数据同步循环")) {
         // 业务逻辑
+        (void)i;
+    }
+
+    // 截断模式：过载时只处理前 10万项，跳过的部分计入统计并提示一次，最坏耗时有界
+    setLoopSiteClamp("业务-批量推送循环", 100000);
+    uint64_t pushed = 0;
+    for (uint64_t i = 0, n = LOOP_CHECKED_SIZE(N, "业务-批量推送循环"); i < n; ++i) {
+        ++pushed;
     }
-    return 0;
-}
\ No newline at end of file
+    dumpLoopSiteStats();
+    return pushed == 100000 ? 0 : 1;
+}
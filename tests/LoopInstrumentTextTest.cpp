@@ -0,0 +1,79 @@
+// loop-instrument 文本改写规则：上限换算（含生成的 inclusiveBound 边界）、计数器命名、缩进、{} 包裹与 #include 插入位置
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "LoopRangeCheck.h"
+#include "tools/LoopInstrumentText.h"
+
+namespace {
+
+int gFailures = 0;
+
+void expectEqual(const char* name, const std::string& actual, const std::string& expected) {
+    const bool ok = actual == expected;
+    std::fprintf(stderr, "%s %s\n", ok ? "[ OK ]" : "[FAIL]", name);
+    if (!ok) {
+        std::fprintf(stderr, "  expected: [%s]\n  actual:   [%s]\n", expected.c_str(), actual.c_str());
+        ++gFailures;
+    }
+}
+
+// 按 includeInsertion 的结果插入后的全文
+std::string withInclude(const std::string& source) {
+    const LoopInstrument::IncludeInsertion include = LoopInstrument::includeInsertion(source);
+    return source.substr(0, include.offset) + include.text + source.substr(include.offset);
+}
+
+} // namespace
+
+int main() {
+    using namespace LoopInstrument;
+
+    expectEqual("bound <", loopBoundArgument("n", "<"), "n");
+    expectEqual("bound !=", loopBoundArgument("v.size()", "!="), "v.size()");
+    expectEqual("bound <= saturates", loopBoundArgument("last - first", "<="),
+                "LoopMonitor::inclusiveBound(last - first)");
+    // 生成的 inclusiveBound：n + 1，边界不回绕
+    expectEqual("inclusiveBound(9u)", std::to_string(LoopMonitor::inclusiveBound(9u)), "10");
+    expectEqual("inclusiveBound(UINT64_MAX) saturates", std::to_string(LoopMonitor::inclusiveBound(UINT64_MAX)),
+                std::to_string(UINT64_MAX));
+    expectEqual("inclusiveBound(-1) stays negative", std::to_string(LoopMonitor::inclusiveBound(-1)), "-1");
+    expectEqual("inclusiveBound(int64_t -1) stays negative",
+                std::to_string(LoopMonitor::inclusiveBound(int64_t{-1})), "-1");
+    expectEqual("inclusiveBound(0)", std::to_string(LoopMonitor::inclusiveBound(0)), "1");
+
+    expectEqual("counter name has column", loopCounterName(12, 5), "loopCnt_12_5");
+    expectEqual("same line, different column", loopCounterName(12, 31), "loopCnt_12_31");
+
+    const std::string code = "int f() {\n\t  while (x) {}\n    if (a) for (;;) {}\n}";
+    expectEqual("indent of loop line", std::string(lineIndent(code, code.find("while"))), "\t  ");
+    expectEqual("indent stops at code", std::string(lineIndent(code, code.find("for"))), "    ");
+    expectEqual("indent of first line", std::string(lineIndent(code, 0)), "");
+
+    const LoopPrologue inBlock = loopPrologue("uint64_t loopCnt_2_3 = 0;", "  ", true);
+    expectEqual("compound parent: own line", inBlock.before, "uint64_t loopCnt_2_3 = 0;\n  ");
+    expectEqual("compound parent: no closing brace", inBlock.after, "");
+    const LoopPrologue underIf = loopPrologue("CHECK_LOOP_DYNAMIC_SIZE(n, \"x\");", "    ", false);
+    expectEqual("if/case parent: open brace", underIf.before, "{ CHECK_LOOP_DYNAMIC_SIZE(n, \"x\"); ");
+    expectEqual("if/case parent: close brace", underIf.after, " }");
+
+    expectEqual("include after existing includes",
+                withInclude("// 说明\n#include <vector>\n#include \"a.h\"\n\nint main() {}\n"),
+                "// 说明\n#include <vector>\n#include \"a.h\"\n#include \"DynamicLoopCheck.h\"\n\nint main() {}\n");
+    expectEqual("include skips conditional includes",
+                withInclude("#include <cstdio>\n#ifdef _WIN32\n#include <windows.h>\n#endif\nint x;\n"),
+                "#include <cstdio>\n#include \"DynamicLoopCheck.h\"\n#ifdef _WIN32\n#include <windows.h>\n#endif\n"
+                "int x;\n");
+    expectEqual("include inside header guard",
+                withInclude("#ifndef A_H\n#define A_H\n#include <vector>\nint x;\n#endif\n"),
+                "#ifndef A_H\n#define A_H\n#include <vector>\n#include \"DynamicLoopCheck.h\"\nint x;\n#endif\n");
+    expectEqual("no includes: after leading comments",
+                withInclude("/* 版权\n * 说明 */\n#pragma once\n// x\nint x;\n"),
+                "/* 版权\n * 说明 */\n#pragma once\n// x\n#include \"DynamicLoopCheck.h\"\nint x;\n");
+    expectEqual("last include without newline", withInclude("#include <vector>"),
+                "#include <vector>\n#include \"DynamicLoopCheck.h\"\n");
+
+    if (gFailures) std::fprintf(stderr, "%d 项改写规则不符合预期\n", gFailures);
+    return gFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
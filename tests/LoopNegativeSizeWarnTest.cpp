@@ -0,0 +1,67 @@
+// 负数 N 的告警与其他超标告警一样每站点每轮一次：同步输出与实时告警两条路径各调用两次只告警一次，
+// resetLoopWarnFlag 开启新一轮后再告警一次；超标计数每次都加
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include "DynamicLoopCheck.h"
+
+namespace {
+
+int gFailures = 0;
+
+void expectEqual(const char* name, uint64_t actual, uint64_t expected) {
+    const bool ok = actual == expected;
+    std::fprintf(stderr, "%s %s | actual: %llu | expected: %llu\n", ok ? "[ OK ]" : "[FAIL]", name,
+                 static_cast<unsigned long long>(actual), static_cast<unsigned long long>(expected));
+    if (!ok) ++gFailures;
+}
+
+// 只数负数 N 的告警
+class NegativeWarnCounter : public LoopMonitor::LoopSink {
+public:
+    void write(const std::vector<const LoopMonitor::LoopEvent*>& batch) override {
+        for (const LoopMonitor::LoopEvent* e : batch) {
+            if (e->text.find("循环次数为负数") != std::string::npos) count.fetch_add(1);
+        }
+    }
+    std::atomic<uint64_t> count{0};
+};
+
+uint64_t realtimeEventsQueued() {
+    uint64_t total = 0;
+    for (auto& ring : LoopMonitor::LOOP_REALTIME_WARN.rings) total += ring.head.load(std::memory_order_relaxed);
+    return total;
+}
+
+} // namespace
+
+int main(int argc, char**) {
+    const int64_t negative = -static_cast<int64_t>(argc);   // 运行时数值，避免编译期折叠
+
+    auto counter = std::make_shared<NegativeWarnCounter>();
+    addLoopSink(counter, {static_cast<uint32_t>(LoopMonitor::LoopEventCategory::Warn)});
+    CHECK_LOOP_DYNAMIC_SIZE(negative, "negative-warn-log");
+    CHECK_LOOP_DYNAMIC_SIZE(negative, "negative-warn-log");
+    flushLoopSinks();
+    expectEqual("logger: two calls, one warning", counter->count.load(), 1);
+    expectEqual("logger: both counted",
+                LoopMonitor::snapshotLoopSite(LOOP_MONITOR_SITE("negative-warn-log")).violations, 2);
+    resetLoopWarnFlag();
+    CHECK_LOOP_DYNAMIC_SIZE(negative, "negative-warn-log");
+    flushLoopSinks();
+    expectEqual("logger: new epoch warns again", counter->count.load(), 2);
+    clearLoopSinks();
+
+    startLoopRealtimeWarn(10);
+    const uint64_t before = realtimeEventsQueued();
+    CHECK_LOOP_DYNAMIC_SIZE(negative, "negative-warn-rt");
+    CHECK_LOOP_DYNAMIC_SIZE(negative, "negative-warn-rt");
+    expectEqual("realtime: two calls, one event", realtimeEventsQueued() - before, 1);
+    expectEqual("realtime: both counted",
+                LoopMonitor::snapshotLoopSite(LOOP_MONITOR_SITE("negative-warn-rt")).violations, 2);
+    stopLoopRealtimeWarn();
+
+    if (gFailures) std::fprintf(stderr, "%d 项负数 N 告警不符合预期\n", gFailures);
+    return gFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+// 性能计数组员打不开时：不可用事件每项只告警一次，汇总统计不输出缺失项（而不是输出 0）；
+// 有线程退化为软件模式时硬件项也不再输出
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include "DynamicLoopCheck.h"
+
+namespace {
+
+int gFailures = 0;
+
+void expectTrue(const char* name, bool ok) {
+    std::fprintf(stderr, "%s %s\n", ok ? "[ OK ]" : "[FAIL]", name);
+    if (!ok) ++gFailures;
+}
+
+// 记下不可用事件的告警
+class UnavailableCounter : public LoopMonitor::LoopSink {
+public:
+    void write(const std::vector<const LoopMonitor::LoopEvent*>& batch) override {
+        for (const LoopMonitor::LoopEvent* e : batch) {
+            if (e->text.find("性能事件不可用") == std::string::npos) continue;
+            count.fetch_add(1);
+            last = e->text;
+        }
+    }
+    std::atomic<uint64_t> count{0};
+    std::string last;
+};
+
+// dumpLoopSiteStats 中本站点那一行
+std::string siteLine(const char* name) {
+    std::ostringstream os;
+    dumpLoopSiteStats(os);
+    const std::string text = os.str();
+    const size_t pos = text.find(std::string("] ") + name + " ");
+    if (pos == std::string::npos) return {};
+    return text.substr(pos, text.find('\n', pos) - pos);
+}
+
+bool contains(const std::string& s, const char* part) { return s.find(part) != std::string::npos; }
+
+} // namespace
+
+int main() {
+    using namespace LoopMonitor;
+    auto counter = std::make_shared<UnavailableCounter>();
+    addLoopSink(counter, {static_cast<uint32_t>(LoopEventCategory::Perf)});
+
+    LoopSite& site = LOOP_MONITOR_SITE("perf-mask");
+    site.stats.perfSamples.store(1);
+    site.stats.instructions.store(300);
+    site.stats.cycles.store(100);
+
+    // 硬件模式，缓存缺失与分支预测失败两个组员打不开
+    notePerfCounterMask(kPerfInstructions | kPerfCycles);
+    notePerfCounterMask(kPerfInstructions | kPerfCycles);
+    flushLoopSinks();
+    expectTrue("unavailable events logged once", counter->count.load() == 1);
+    expectTrue("log names the missing events",
+               contains(counter->last, "LLC-Misses") && contains(counter->last, "Branch-Misses") &&
+               !contains(counter->last, "Cycles"));
+    const std::string partial = siteLine("perf-mask");
+    expectTrue("opened counters reported", contains(partial, "Instructions: 300") && contains(partial, "IPC: 3"));
+    expectTrue("missing counters not reported as 0",
+               !contains(partial, "LLC-Misses") && !contains(partial, "Branch-Misses") && !contains(partial, "CPU(ns)"));
+
+    // 另一个线程退化为软件模式：指令数/周期数也只有部分线程采到，不再输出
+    notePerfCounterMask(kPerfCpuTime);
+    flushLoopSinks();
+    expectTrue("fallback logged once more", counter->count.load() == 2 && contains(counter->last, "退化"));
+    const std::string mixed = siteLine("perf-mask");
+    expectTrue("partially recorded counters not reported",
+               contains(mixed, "PerfSamples: 1") && !contains(mixed, "Instructions") && !contains(mixed, "CPU(ns)"));
+    clearLoopSinks();
+
+    if (gFailures) std::fprintf(stderr, "%d 项性能计数有效性处理不符合预期\n", gFailures);
+    return gFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+// 跨重启持久状态：用户配置以本次启动为准、显式设置的单次迭代耗时不被覆盖、重启前的累计统计不并入站点统计
+// 每一轮"进程"各 fork 一个子进程运行，共用同一个快照文件
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "DynamicLoopCheck.h"
+
+namespace {
+
+int gFailures = 0;
+
+void expect(const char* name, bool ok, uint64_t actual, uint64_t expected) {
+    std::fprintf(stderr, "%s %s | actual: %llu | expected: %llu\n", ok ? "[ OK ]" : "[FAIL]", name,
+                 static_cast<unsigned long long>(actual), static_cast<unsigned long long>(expected));
+    if (!ok) ++gFailures;
+}
+
+void expectEqual(const char* name, uint64_t actual, uint64_t expected) {
+    expect(name, actual == expected, actual, expected);
+}
+
+constexpr uint64_t kLearnedQ16 = uint64_t{5} << 16;
+constexpr uint64_t kFirstRunQ16 = uint64_t{7} << 16;
+constexpr uint64_t kExplicitQ16 = uint64_t{9} << 16;
+
+// 第一轮：采样率 4，学到单次迭代耗时，累计若干次调用
+int firstRun(const std::string& path, uint64_t n) {
+    setLoopSampleRate("persist-override", 4);
+    if (!startLoopStatePersistence(path)) return EXIT_FAILURE;
+    for (int i = 0; i < 40; ++i) CHECK_LOOP_DYNAMIC_SIZE(n, "persist-override");
+    LOOP_MONITOR_SITE("persist-override").nsPerIterQ16.store(kLearnedQ16);
+    LOOP_MONITOR_SITE("persist-explicit").nsPerIterQ16.store(kFirstRunQ16);
+    stopLoopStatePersistence();
+    return EXIT_SUCCESS;
+}
+
+// 第二轮（重启）：启动前改采样率为 1、给另一个站点显式设置单次迭代耗时
+int secondRun(const std::string& path, uint64_t n) {
+    setLoopSampleRate("persist-override", 1);
+    LoopMonitor::LoopSite& explicitSite = LOOP_MONITOR_SITE("persist-explicit");
+    explicitSite.nsPerIterQ16.store(kExplicitQ16);
+    if (!startLoopStatePersistence(path)) return EXIT_FAILURE;
+    LoopMonitor::LoopSite& site = LOOP_MONITOR_SITE("persist-override");
+
+    expectEqual("sample rate set before restart wins", site.sampleRate.load(), 1);
+    expectEqual("learned ns/iter restored", site.nsPerIterQ16.load(), kLearnedQ16);
+    expectEqual("explicit ns/iter kept", explicitSite.nsPerIterQ16.load(), kExplicitQ16);
+
+    auto& st = LoopMonitor::LOOP_PERSIST;
+    uint64_t restored = 0;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        restored = st.restoredTotals[site.nameHash].invocations;
+    }
+    expect("first run's calls restored (> 0)", restored > 0, restored, 1);
+    expectEqual("live stats start from zero", LoopMonitor::snapshotLoopSite(site).invocations, 0);
+
+    for (int i = 0; i < 5; ++i) CHECK_LOOP_DYNAMIC_SIZE(n, "persist-override");
+    expectEqual("live stats count this process only", LoopMonitor::snapshotLoopSite(site).invocations, 5);
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        LoopMonitor::checkpointLoopStateLocked(st);
+        const LoopMonitor::LoopPersistRecord* rec = LoopMonitor::findLoopPersistRecord(st, site, false);
+        const uint64_t persisted = rec ? rec->slots[rec->active.load() & 1].invocations : 0;
+        expectEqual("snapshot keeps the running total", persisted, restored + 5);
+    }
+    stopLoopStatePersistence();
+    return gFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+template <typename Fn>
+bool runInChild(const char* name, Fn&& fn) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        std::fflush(stderr);
+        _exit(fn());
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    const bool ok = pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+    std::fprintf(stderr, "%s %s\n", ok ? "[ OK ]" : "[FAIL]", name);
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char**) {
+    const uint64_t n = static_cast<uint64_t>(argc) * 10;
+    char dir[] = "/tmp/loop-persist-test.XXXXXX";
+    if (!mkdtemp(dir)) return EXIT_FAILURE;
+    const std::string path = std::string(dir) + "/loop.state";
+
+    bool ok = runInChild("first run", [&] { return firstRun(path, n); });
+    ok = runInChild("restart", [&] { return secondRun(path, n); }) && ok;
+
+    unlink(path.c_str());
+    rmdir(dir);
+    if (!ok) std::fprintf(stderr, "持久状态跨重启的行为不符合预期\n");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,135 @@
+// 实时告警模式下各超标路径不分配、不加锁
+// 以 LOOP_MONITOR_ALLOC_TRACKING=1 编译并链接 LoopAllocHooks.cpp（统计 operator new），
+// 本文件再替换 malloc/calloc/realloc 与 pthread_mutex_lock：武装期间任何一次调用都算失败
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <pthread.h>
+#include "DynamicLoopCheck.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+}
+
+namespace {
+
+thread_local bool gArmed = false;
+thread_local uint64_t gMallocs = 0;
+thread_local uint64_t gLocks = 0;
+
+using MutexLockFn = int (*)(pthread_mutex_t*);
+MutexLockFn gRealMutexLock = nullptr;
+
+} // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+    if (gArmed) ++gMallocs;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (gArmed) ++gMallocs;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+    if (gArmed) ++gMallocs;
+    return __libc_realloc(p, size);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* m) {
+    if (gArmed) ++gLocks;
+    if (!gRealMutexLock) gRealMutexLock = reinterpret_cast<MutexLockFn>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+    return gRealMutexLock(m);
+}
+
+} // extern "C"
+
+namespace {
+
+int gFailures = 0;
+
+uint64_t realtimeEventsQueued() {
+    uint64_t total = 0;
+    for (auto& ring : LoopMonitor::LOOP_REALTIME_WARN.rings) total += ring.head.load(std::memory_order_relaxed);
+    return total;
+}
+
+// 武装后执行 fn：不得有 operator new / malloc / 加锁；expectEvent 为 true 时必须写入环
+template <typename Fn>
+void expectRealtime(const char* name, bool expectEvent, Fn&& fn) {
+    const uint64_t newsBefore = LoopMonitor::LOOP_ALLOC_COUNTERS.allocations;
+    const uint64_t eventsBefore = realtimeEventsQueued();
+    gMallocs = 0;
+    gLocks = 0;
+    gArmed = true;
+    fn();
+    gArmed = false;
+    const uint64_t news = LoopMonitor::LOOP_ALLOC_COUNTERS.allocations - newsBefore;
+    const uint64_t events = realtimeEventsQueued() - eventsBefore;
+    const bool ok = news == 0 && gMallocs == 0 && gLocks == 0 && (!expectEvent || events > 0);
+    std::fprintf(stderr, "%s %s | new: %llu | malloc: %llu | mutex: %llu | events: %llu\n", ok ? "[ OK ]" : "[FAIL]",
+                 name, static_cast<unsigned long long>(news), static_cast<unsigned long long>(gMallocs),
+                 static_cast<unsigned long long>(gLocks), static_cast<unsigned long long>(events));
+    if (!ok) ++gFailures;
+}
+
+} // namespace
+
+int main(int argc, char**) {
+    static_assert(LOOP_MONITOR_ALLOC_TRACKING, "需以 LOOP_MONITOR_ALLOC_TRACKING=1 编译并链接 LoopAllocHooks.cpp");
+    gRealMutexLock = reinterpret_cast<MutexLockFn>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+
+    // 运行时数值，避免编译期折叠
+    const uint64_t big = static_cast<uint64_t>(argc) * 2000000;
+    const int64_t negative = -static_cast<int64_t>(argc);
+    const uint64_t clamped = static_cast<uint64_t>(argc) * 100;
+
+    // 启动阶段：登记站点、设置配置（这些路径允许分配与加锁）
+    (void)LOOP_MONITOR_SITE("rt-size");
+    (void)LOOP_MONITOR_SITE("rt-negative");
+    (void)LOOP_MONITOR_SITE("rt-clamp");
+    (void)LOOP_MONITOR_SITE("rt-break");
+    (void)LOOP_MONITOR_SITE("rt-count");
+    (void)LOOP_MONITOR_SITE("rt-guard");
+    (void)LOOP_MONITOR_SITE("rt-request");
+    LoopMonitor::LoopSite& timeSite = LOOP_MONITOR_SITE("rt-time");
+    setLoopSiteClamp("rt-clamp", 10);
+    setLoopSiteTimeBudget("rt-time", 1);
+    timeSite.nsPerIterQ16.store(uint64_t{1000} << 16);   // 1us/迭代：2000 次即超过 1ms
+    auto request = makeLoopRequestBudget("rt-request-42", 1000);
+    startLoopRealtimeWarn(10);
+
+    expectRealtime("size violation", true, [&] { CHECK_LOOP_DYNAMIC_SIZE(big, "rt-size"); });
+    expectRealtime("size violation (already warned)", false, [&] { CHECK_LOOP_DYNAMIC_SIZE(big, "rt-size"); });
+    expectRealtime("negative size", true, [&] { CHECK_LOOP_DYNAMIC_SIZE(negative, "rt-negative"); });
+    expectRealtime("clamp", true, [&] { (void)LOOP_CHECKED_SIZE(clamped, "rt-clamp"); });
+    expectRealtime("time budget", true, [&] { CHECK_LOOP_DYNAMIC_SIZE(clamped * 100, "rt-time"); });
+    expectRealtime("guard violation", true, [&] { LOOP_MONITOR_GUARD(big, "rt-guard"); });
+    expectRealtime("count overflow", true, [&] {
+        uint64_t count = LoopMonitorConfig::LOOP_WARN_THRESHOLD.load();
+        LOOP_DYNAMIC_COUNT_CHECK(count, "rt-count");
+    });
+    LoopMonitorConfig::ENABLE_LOOP_BREAK = true;
+    expectRealtime("loop break", true, [&] {
+        for (int i = 0; i < 1; ++i) CHECK_LOOP_DYNAMIC_SIZE(big, "rt-break");
+    });
+    LoopMonitorConfig::ENABLE_LOOP_BREAK = false;
+    {
+        LOOP_REQUEST_SCOPE(request);
+        // 本地扣减攒满一批才合入共享计数并判定耗尽
+        expectRealtime("request budget exhausted", true, [&] {
+            for (uint64_t i = 0; i <= LoopMonitor::kRequestBudgetFlushBatch / clamped; ++i) {
+                CHECK_LOOP_DYNAMIC_SIZE(clamped, "rt-request");
+            }
+        });
+    }
+
+    stopLoopRealtimeWarn();
+    if (gFailures) std::fprintf(stderr, "%d 个实时路径发生了分配或加锁\n", gFailures);
+    return gFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,49 @@
+// 请求时间预算在请求运行中判定：循环短而慢（远不到一批迭代数）时，作用域结束前即标记耗尽
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include "DynamicLoopCheck.h"
+
+namespace {
+
+int gFailures = 0;
+
+void expectTrue(const char* name, bool ok) {
+    std::fprintf(stderr, "%s %s\n", ok ? "[ OK ]" : "[FAIL]", name);
+    if (!ok) ++gFailures;
+}
+
+// 每次校验 10 次迭代、每轮睡 200us，最多 rounds 轮；返回耗尽前执行的轮数
+uint64_t runSlowLoops(const std::shared_ptr<LoopMonitor::LoopRequestBudget>& budget, uint64_t n, uint64_t rounds) {
+    LOOP_REQUEST_SCOPE(budget);
+    for (uint64_t round = 0; round < rounds; ++round) {
+        CHECK_LOOP_DYNAMIC_SIZE(n, "request-time-slow");
+        if (budget->exhausted()) return round + 1;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    return rounds;
+}
+
+} // namespace
+
+int main(int argc, char**) {
+    const uint64_t n = static_cast<uint64_t>(argc) * 10;   // 运行时数值，避免编译期折叠
+    setLoopSampleRate("request-time-slow", 1);
+
+    // 5ms 预算：约 25 轮即超时，64 轮一次的时钟检查在 128 轮内判定
+    auto timed = makeLoopRequestBudget("req-time", 0, 5);
+    const uint64_t rounds = runSlowLoops(timed, n, 1000);
+    std::fprintf(stderr, "rounds before exhaustion: %llu | iterations: %llu\n",
+                 static_cast<unsigned long long>(rounds), static_cast<unsigned long long>(timed->iterationsUsed()));
+    expectTrue("time budget exhausted while the request runs", rounds < 1000);
+    expectTrue("detected within two clock-check periods", rounds <= 2 * LoopMonitor::kRequestBudgetClockCheckCalls);
+    expectTrue("exhausting site recorded", timed->exhaustedBy() == &LOOP_MONITOR_SITE("request-time-slow"));
+
+    // 不限时的预算不读时钟、不会因时间耗尽
+    auto untimed = makeLoopRequestBudget("req-untimed", 0, 0);
+    expectTrue("no time limit, never exhausted", runSlowLoops(untimed, n, 200) == 200 && !untimed->exhausted());
+
+    if (gFailures) std::fprintf(stderr, "%d 项请求预算判定不符合预期\n", gFailures);
+    return gFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
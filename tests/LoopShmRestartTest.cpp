@@ -0,0 +1,68 @@
+// 共享内存段被删除重建（同 pid 重启/停止后重新发布）：旧映射停在旧段上，
+// remapIfReplaced 按 inode 发现新段并重新映射，读到新段的头部与记录
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "DynamicLoopCheck.h"
+
+namespace {
+
+int gFailures = 0;
+
+void expectTrue(const char* name, bool ok) {
+    std::fprintf(stderr, "%s %s\n", ok ? "[ OK ]" : "[FAIL]", name);
+    if (!ok) ++gFailures;
+}
+
+// 等发布线程写完首轮数据
+void waitPublished(const LoopMonitor::LoopShmReader& reader) {
+    for (int i = 0; i < 1000 && reader.header().publishSeq.load(std::memory_order_acquire) == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// 按名字查记录的调用次数，没有时返回 0
+uint64_t invocationsOf(const LoopMonitor::LoopShmReader& reader, const char* name) {
+    LoopMonitor::LoopShmRecordView view{};
+    for (uint32_t i = 0; i < reader.siteCount(); ++i) {
+        if (reader.read(i, view) && std::strcmp(view.name, name) == 0) return view.invocations;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char**) {
+    const uint64_t n = static_cast<uint64_t>(argc) * 10;   // 运行时数值，避免编译期折叠
+    const std::string name = LoopMonitor::loopShmName(static_cast<int>(getpid()));
+    setLoopSampleRate("shm-restart", 1);
+    CHECK_LOOP_DYNAMIC_SIZE(n, "shm-restart");
+
+    if (!startLoopShmPublisher(1000)) return EXIT_FAILURE;
+    LoopMonitor::LoopShmReader reader;
+    LoopMonitor::LoopShmReader stale;
+    expectTrue("open first segment", reader.open(name) && stale.open(name));
+    waitPublished(reader);
+    const uint64_t firstStart = reader.header().startTimeNs;
+    expectTrue("same segment is not remapped", !reader.remapIfReplaced(name) && reader.isOpen());
+
+    // 停止发布删除段：旧映射保留，不算重建
+    stopLoopShmPublisher();
+    expectTrue("removed segment keeps the old mapping", !reader.remapIfReplaced(name) && reader.isOpen());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    CHECK_LOOP_DYNAMIC_SIZE(n, "shm-restart");
+    if (!startLoopShmPublisher(1000)) return EXIT_FAILURE;
+    expectTrue("recreated segment is remapped", reader.remapIfReplaced(name) && reader.isOpen());
+    waitPublished(reader);
+    expectTrue("new header visible", reader.header().startTimeNs != firstStart);
+    expectTrue("new records visible", invocationsOf(reader, "shm-restart") == 2);
+    expectTrue("unremapped reader still sees the old segment",
+               stale.header().startTimeNs == firstStart && invocationsOf(stale, "shm-restart") == 1);
+    stopLoopShmPublisher();
+
+    if (gFailures) std::fprintf(stderr, "%d 项共享内存重建检测不符合预期\n", gFailures);
+    return gFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
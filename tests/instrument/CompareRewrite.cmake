@@ -0,0 +1,25 @@
+# 用 loop-instrument 改写 INPUT，输出须与 EXPECTED 逐字节相同；再改写 EXPECTED，输出须不变（幂等）
+# 参数：TOOL INPUT EXPECTED SOURCE_DIR（DynamicLoopCheck.h 所在目录）[RESOURCE_DIR]
+set(flags -std=c++2b -I${SOURCE_DIR})
+if(RESOURCE_DIR)
+    list(APPEND flags -resource-dir=${RESOURCE_DIR})
+endif()
+
+function(rewrite file out)
+    execute_process(COMMAND ${TOOL} ${file} -- ${flags}
+                    OUTPUT_VARIABLE result ERROR_VARIABLE errors RESULT_VARIABLE rc)
+    if(NOT rc EQUAL 0)
+        message(FATAL_ERROR "loop-instrument ${file} 失败（${rc}）：\n${errors}")
+    endif()
+    set(${out} "${result}" PARENT_SCOPE)
+endfunction()
+
+file(READ ${EXPECTED} expected)
+rewrite(${INPUT} actual)
+if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "改写结果与 ${EXPECTED} 不同：\n${actual}")
+endif()
+rewrite(${EXPECTED} again)
+if(NOT again STREQUAL expected)
+    message(FATAL_ERROR "重复改写不幂等：\n${again}")
+endif()
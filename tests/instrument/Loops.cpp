@@ -0,0 +1,74 @@
+// loop-instrument 改写用例：Loops.cpp 为输入，Loops.expected.cpp 为期望输出（两者都编译运行）
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+uint64_t sumThrough(const std::vector<uint64_t>& values, uint64_t last) {
+    uint64_t total = 0;
+    for (uint64_t i = 0; i <= last; ++i) total += values[i];
+    return total;
+}
+
+uint64_t sumIf(const std::vector<uint64_t>& values, bool enabled) {
+    uint64_t total = 0;
+    if (enabled)
+        for (uint64_t v : values) total += v;
+    return total;
+}
+
+uint64_t countBoth(uint64_t n) {
+    uint64_t a = 0;
+    uint64_t b = 0;
+    while (a < n) { ++a; } while (b < n) { b += 2; }
+    return a + b;
+}
+
+uint64_t dispatch(int kind, uint64_t n) {
+    uint64_t steps = 0;
+    switch (kind) {
+    case 0:
+        while (steps < n) { ++steps; }
+        break;
+    case 1:
+        for (uint64_t i = 0; i != n; ++i) ++steps;
+        break;
+    default:
+        break;
+    }
+    return steps;
+}
+
+uint64_t skipped(uint64_t n) {
+    uint64_t total = 0;
+    // loop-monitor: skip
+    for (uint64_t i = 0; i < n; ++i) total += i;
+    return total;
+}
+
+uint64_t fillTable(std::vector<uint64_t>& table) {
+    constexpr uint64_t kTableSize = 4096;
+    table.resize(kTableSize);
+    for (uint64_t i = 0; i < kTableSize; ++i) table[i] = i;
+    uint64_t small = 0;
+    for (int i = 0; i < 8; ++i) small += table[i];
+    return small;
+}
+
+} // namespace
+
+int main() {
+    const std::vector<uint64_t> values{1, 2, 3, 4};
+    int failures = 0;
+    failures += sumThrough(values, 3) != 10;
+    failures += sumIf(values, true) != 10;
+    failures += countBoth(5) != 11;
+    failures += dispatch(0, 7) != 7;
+    failures += dispatch(1, 7) != 7;
+    failures += skipped(4) != 6;
+    std::vector<uint64_t> table;
+    failures += fillTable(table) != 28;
+    if (failures) std::fprintf(stderr, "%d 项结果不符\n", failures);
+    return failures;
+}
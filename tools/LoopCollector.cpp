@@ -0,0 +1,297 @@
+// loop-collector：主机级汇总进程，接收各被监控进程的站点累计值，按 pid 求差后按站点名合并
+// 用法：loop-collector [-S 套接字路径] [-o 输出文件] [-p 本机端口] [-i 输出周期毫秒]
+//       -o 每周期原子替换一次文本文件；-p 在 127.0.0.1 上监听，连接即返回当前汇总后关闭
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "LoopCollector.h"
+
+namespace {
+
+struct Options {
+    std::string socketPath = LoopMonitor::kDefaultCollectorSocket;
+    std::string outputPath;
+    int port = 0;
+    uint64_t intervalMs = 1000;
+};
+
+// 站点跨进程累计
+struct SiteTotals {
+    std::string name;
+    uint64_t invocations = 0;
+    uint64_t iterations = 0;
+    uint64_t violations = 0;
+    uint64_t timedInvocations = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxN = 0;
+    std::map<int, uint64_t> lastSeenNs;   // 上报过该站点的进程
+};
+
+// 进程上次上报的站点累计值（求差用）
+struct SiteCumulative {
+    uint64_t invocations = 0;
+    uint64_t iterations = 0;
+    uint64_t violations = 0;
+    uint64_t timedInvocations = 0;
+    uint64_t totalNs = 0;
+};
+
+struct PeerState {
+    uint64_t lastBatchSeq = 0;
+    uint64_t lostBatches = 0;
+    uint64_t lastSeenNs = 0;
+    std::unordered_map<uint64_t, SiteCumulative> sites;   // 键为站点名哈希
+};
+
+// 累计值求差；比上次小说明计数源已重置（同 pid 的新进程），整值计为增量
+uint64_t cumulativeDelta(uint64_t cur, uint64_t& last) {
+    const uint64_t delta = cur >= last ? cur - last : cur;
+    last = cur;
+    return delta;
+}
+
+// 进程超过 expireNs × 该倍数未上报才丢弃其累计基准
+constexpr uint64_t kPeerRetention = 6;
+
+volatile std::sig_atomic_t gStop = 0;
+
+void usage(const char* argv0) {
+    std::fprintf(stderr, "usage: %s [-S socket] [-o file] [-p port] [-i interval_ms]\n", argv0);
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        if (arg == "-S") opt.socketPath = argv[++i];
+        else if (arg == "-o") opt.outputPath = argv[++i];
+        else if (arg == "-p") opt.port = std::atoi(argv[++i]);
+        else if (arg == "-i") opt.intervalMs = std::max<uint64_t>(100, std::strtoull(argv[++i], nullptr, 10));
+        else return false;
+    }
+    return true;
+}
+
+int bindDatagramSocket(const std::string& path) {
+    sockaddr_un addr {};
+    if (path.size() >= sizeof(addr.sun_path)) return -1;
+    const int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+    // 套接字文件创建即为 0660：只有同组的工作进程能上报，bind 与 chmod 之间也没有放开的窗口
+    const mode_t oldMask = umask(0117);
+    const int rc = bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    umask(oldMask);
+    if (rc != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // 放大接收缓冲，削峰时少丢包
+    int rcvbuf = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return fd;
+}
+
+int listenLocalhost(int port) {
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+class Collector {
+public:
+    void ingest(const char* data, size_t len) {
+        using namespace LoopMonitor;
+        if (len < sizeof(LoopCollectorHeader)) return;
+        LoopCollectorHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != kCollectorMagic || header.version != kCollectorVersion ||
+            header.recordCount > kCollectorBatchSites ||
+            len < sizeof(header) + sizeof(LoopCollectorRecord) * header.recordCount) {
+            ++malformed_;
+            return;
+        }
+        const uint64_t nowNs = monotonicNs();
+        PeerState& peer = peers_[header.pid];
+        // 序号回退视为同 pid 的新进程：累计值从 0 重新求差
+        if (peer.lastBatchSeq && header.batchSeq <= peer.lastBatchSeq) peer.sites.clear();
+        if (peer.lastBatchSeq && header.batchSeq > peer.lastBatchSeq + 1) {
+            peer.lostBatches += header.batchSeq - peer.lastBatchSeq - 1;
+        }
+        peer.lastBatchSeq = header.batchSeq;
+        peer.lastSeenNs = nowNs;
+        for (uint32_t i = 0; i < header.recordCount; ++i) {
+            LoopCollectorRecord rec;
+            std::memcpy(&rec, data + sizeof(header) + sizeof(rec) * i, sizeof(rec));
+            rec.name[kCollectorNameLen - 1] = '\0';
+            SiteTotals& t = sites_[rec.nameHash];
+            SiteCumulative& last = peer.sites[rec.nameHash];
+            if (t.name.empty()) t.name = rec.name;
+            t.invocations += cumulativeDelta(rec.invocations, last.invocations);
+            t.iterations += cumulativeDelta(rec.iterations, last.iterations);
+            t.violations += cumulativeDelta(rec.violations, last.violations);
+            t.timedInvocations += cumulativeDelta(rec.timedInvocations, last.timedInvocations);
+            t.totalNs += cumulativeDelta(rec.totalNs, last.totalNs);
+            t.maxN = std::max(t.maxN, rec.maxN);
+            t.lastSeenNs[header.pid] = nowNs;
+        }
+        ++batches_;
+    }
+
+    // 超过 expireNs 未上报的进程不再计入 PROCS；其累计基准保留到 kPeerRetention 倍之后才丢弃，
+    // 否则同一进程恢复上报时会把全部累计值再计入一次
+    std::string render(uint64_t expireNs) {
+        const uint64_t nowNs = LoopMonitor::monotonicNs();
+        uint64_t lost = 0;
+        size_t livePeers = 0;
+        for (auto it = peers_.begin(); it != peers_.end();) {
+            const uint64_t idleNs = nowNs - it->second.lastSeenNs;
+            if (idleNs > expireNs * kPeerRetention) {
+                retiredLost_ += it->second.lostBatches;
+                it = peers_.erase(it);
+                continue;
+            }
+            lost += it->second.lostBatches;
+            if (idleNs <= expireNs) ++livePeers;
+            ++it;
+        }
+        std::string out;
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "# processes=%zu sites=%zu batches=%llu lost=%llu malformed=%llu\n"
+                      "# SITE\tPROCS\tCALLS\tITERATIONS\tVIOLATIONS\tMAXN\tTIMED\tTIME_NS\n",
+                      livePeers, sites_.size(), static_cast<unsigned long long>(batches_),
+                      static_cast<unsigned long long>(lost + retiredLost_),
+                      static_cast<unsigned long long>(malformed_));
+        out += line;
+        for (auto& [hash, t] : sites_) {
+            std::erase_if(t.lastSeenNs, [&](const auto& kv) { return nowNs - kv.second > expireNs; });
+            std::snprintf(line, sizeof(line), "%s\t%zu\t%llu\t%llu\t%llu\t%llu\t%llu\t%llu\n", t.name.c_str(),
+                          t.lastSeenNs.size(), static_cast<unsigned long long>(t.invocations),
+                          static_cast<unsigned long long>(t.iterations),
+                          static_cast<unsigned long long>(t.violations), static_cast<unsigned long long>(t.maxN),
+                          static_cast<unsigned long long>(t.timedInvocations),
+                          static_cast<unsigned long long>(t.totalNs));
+            out += line;
+        }
+        return out;
+    }
+
+private:
+    std::map<uint64_t, SiteTotals> sites_;   // 键为站点名哈希
+    std::unordered_map<int, PeerState> peers_;
+    uint64_t batches_ = 0;
+    uint64_t malformed_ = 0;
+    uint64_t retiredLost_ = 0;
+};
+
+// 先写临时文件再 rename，读者不会看到半截内容
+void writeOutputFile(const std::string& path, const std::string& text) {
+    const std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "w");
+    if (!f) return;
+    std::fwrite(text.data(), 1, text.size(), f);
+    std::fclose(f);
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+void serveClient(int listenFd, const std::string& text) {
+    const int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) return;
+    size_t off = 0;
+    while (off < text.size()) {
+        const ssize_t n = send(fd, text.data() + off, text.size() - off, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        off += static_cast<size_t>(n);
+    }
+    close(fd);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::signal(SIGINT, [](int) { gStop = 1; });
+    std::signal(SIGTERM, [](int) { gStop = 1; });
+
+    const int dgramFd = bindDatagramSocket(opt.socketPath);
+    if (dgramFd < 0) {
+        std::fprintf(stderr, "[LOOP_COLLECTOR] 绑定失败: %s (%s)\n", opt.socketPath.c_str(), std::strerror(errno));
+        return 1;
+    }
+    int listenFd = -1;
+    if (opt.port > 0 && (listenFd = listenLocalhost(opt.port)) < 0) {
+        std::fprintf(stderr, "[LOOP_COLLECTOR] 监听端口失败: %d (%s)\n", opt.port, std::strerror(errno));
+        return 1;
+    }
+    std::fprintf(stderr, "[LOOP_COLLECTOR] 已启动 | 套接字: %s\n", opt.socketPath.c_str());
+
+    Collector collector;
+    const uint64_t expireNs = opt.intervalMs * 1000000ULL * 10;
+    std::vector<char> buf(sizeof(LoopMonitor::LoopCollectorHeader) +
+                          sizeof(LoopMonitor::LoopCollectorRecord) * LoopMonitor::kCollectorBatchSites);
+    uint64_t nextOutputNs = LoopMonitor::monotonicNs() + opt.intervalMs * 1000000ULL;
+
+    while (!gStop) {
+        pollfd fds[2] = {{dgramFd, POLLIN, 0}, {listenFd, POLLIN, 0}};
+        const uint64_t nowNs = LoopMonitor::monotonicNs();
+        const int timeoutMs = nowNs >= nextOutputNs ? 0 : static_cast<int>((nextOutputNs - nowNs) / 1000000 + 1);
+        const int ready = poll(fds, listenFd >= 0 ? 2 : 1, timeoutMs);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            // 一次唤醒尽量收空，再回到 poll
+            for (;;) {
+                const ssize_t n = recv(dgramFd, buf.data(), buf.size(), MSG_DONTWAIT);
+                if (n < 0) break;
+                collector.ingest(buf.data(), static_cast<size_t>(n));
+            }
+        }
+        if (ready > 0 && listenFd >= 0 && (fds[1].revents & POLLIN)) {
+            serveClient(listenFd, collector.render(expireNs));
+        }
+        if (!opt.outputPath.empty() && LoopMonitor::monotonicNs() >= nextOutputNs) {
+            writeOutputFile(opt.outputPath, collector.render(expireNs));
+        }
+        if (const uint64_t t = LoopMonitor::monotonicNs(); t >= nextOutputNs) {
+            nextOutputNs = t + opt.intervalMs * 1000000ULL;
+        }
+    }
+
+    if (!opt.outputPath.empty()) writeOutputFile(opt.outputPath, collector.render(expireNs));
+    close(dgramFd);
+    if (listenFd >= 0) close(listenFd);
+    unlink(opt.socketPath.c_str());
+    return 0;
+}
@@ -0,0 +1,309 @@
+// loop-instrument：基于 LibTooling 的源到源改写工具，自动为循环插入监控守卫
+// 用法：loop-instrument -p build/ [-i] [--while-loops=false] [--function-filter='^Biz'] [--constant-bound-cutoff=1024] a.cpp b.cpp
+// 退出：用 LOOP_MONITOR_SKIP 标注循环，或在循环上一行写 "// loop-monitor: skip"
+#include <memory>
+#include <set>
+#include <string>
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/ParentMapContext.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Rewrite/Core/Rewriter.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "LoopInstrumentText.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+
+namespace {
+
+llvm::cl::OptionCategory ToolCategory("loop-instrument options");
+
+llvm::cl::opt<bool> InPlace("i", llvm::cl::desc("直接改写源文件（默认输出到 stdout）"),
+                            llvm::cl::cat(ToolCategory));
+llvm::cl::opt<bool> ForLoops("for-dynamic-bounds", llvm::cl::init(true),
+                             llvm::cl::desc("for 循环：上限为非常量表达式时插入 CHECK_LOOP_DYNAMIC_SIZE"),
+                             llvm::cl::cat(ToolCategory));
+llvm::cl::opt<bool> RangeLoops("range-for", llvm::cl::init(true),
+                               llvm::cl::desc("范围 for：遍历带 size() 的容器时插入 CHECK_LOOP_DYNAMIC_SIZE"),
+                               llvm::cl::cat(ToolCategory));
+llvm::cl::opt<bool> WhileLoops("while-loops", llvm::cl::init(true),
+                               llvm::cl::desc("while 循环：插入计数器与 LOOP_DYNAMIC_COUNT_CHECK"),
+                               llvm::cl::cat(ToolCategory));
+llvm::cl::opt<std::string> FunctionFilter("function-filter", llvm::cl::init(""),
+                                          llvm::cl::desc("只改写函数名匹配该正则的循环"),
+                                          llvm::cl::cat(ToolCategory));
+llvm::cl::opt<uint64_t> ConstantBoundCutoff("constant-bound-cutoff", llvm::cl::init(1024),
+                                           llvm::cl::desc("常量上限小于该值的 for 循环不插桩（0 表示常量上限一律插桩）"),
+                                           llvm::cl::cat(ToolCategory));
+llvm::cl::opt<std::string> NamePrefix("name-prefix", llvm::cl::init("auto-"),
+                                      llvm::cl::desc("生成的站点名前缀"),
+                                      llvm::cl::cat(ToolCategory));
+
+constexpr const char* kSkipAnnotation = "loop_monitor_skip";
+constexpr const char* kSkipComment = "loop-monitor: skip";
+
+class LoopInstrumenter : public MatchFinder::MatchCallback {
+public:
+    explicit LoopInstrumenter(Rewriter& rewriter) : rewriter_(rewriter), filter_(FunctionFilter) {}
+
+    void run(const MatchFinder::MatchResult& result) override {
+        ASTContext& ctx = *result.Context;
+        if (const auto* loop = result.Nodes.getNodeAs<ForStmt>("for")) {
+            const auto* bound = result.Nodes.getNodeAs<Expr>("bound");
+            const auto* cond = result.Nodes.getNodeAs<BinaryOperator>("cond");
+            if (!accept(loop, ctx) || !bound || !cond) return;
+            // 有副作用的上限不能重复求值；常量上限同样在运行时校验（阈值运行时可调），只跳过小于截断值的小循环
+            if (bound->isValueDependent() || bound->HasSideEffects(ctx, /*IncludePossibleEffects=*/false) ||
+                isSmallConstant(bound, ctx)) {
+                return;
+            }
+            const std::string size = LoopInstrument::loopBoundArgument(text(bound, ctx), cond->getOpcodeStr().str());
+            insertBefore(loop, "CHECK_LOOP_DYNAMIC_SIZE(" + size + ", \"" + siteName(loop, ctx) + "\");", ctx);
+        } else if (const auto* loop = result.Nodes.getNodeAs<CXXForRangeStmt>("rangeFor")) {
+            const Expr* range = loop->getRangeInit();
+            if (!accept(loop, ctx) || !range || range->HasSideEffects(ctx, false)) return;
+            if (!hasSizeMember(range->getType())) return;
+            insertBefore(loop, "CHECK_LOOP_DYNAMIC_SIZE(" + text(range, ctx) + ", \"" +
+                                   siteName(loop, ctx) + "\");",
+                         ctx);
+        } else if (const auto* loop = result.Nodes.getNodeAs<WhileStmt>("while")) {
+            const auto* body = dyn_cast<CompoundStmt>(loop->getBody());
+            if (!accept(loop, ctx) || !body) return;
+            const SourceManager& sm = ctx.getSourceManager();
+            const SourceLocation begin = sm.getExpansionLoc(loop->getBeginLoc());
+            const std::string counter = LoopInstrument::loopCounterName(sm.getExpansionLineNumber(begin),
+                                                                        sm.getExpansionColumnNumber(begin));
+            insertBefore(loop, "uint64_t " + counter + " = 0;", ctx);
+            rewriter_.InsertTextAfterToken(body->getLBracLoc(),
+                                           " LOOP_DYNAMIC_COUNT_CHECK(" + counter + ", \"" +
+                                               siteName(loop, ctx) + "\");");
+            markFile(loop, ctx);
+        }
+    }
+
+    const std::set<FileID>& touchedFiles() const { return touched_; }
+
+private:
+    bool accept(const Stmt* loop, ASTContext& ctx) {
+        const SourceManager& sm = ctx.getSourceManager();
+        const SourceLocation begin = loop->getBeginLoc();
+        if (begin.isMacroID() || !sm.isInMainFile(begin)) return false;
+        if (!done_.insert(begin.getRawEncoding()).second) return false;
+        if (isOptedOut(loop, ctx) || alreadyInstrumented(loop, ctx)) return false;
+        const FunctionDecl* fn = enclosingFunction(loop, ctx);
+        if (fn && fn->hasAttr<AnnotateAttr>() &&
+            fn->getAttr<AnnotateAttr>()->getAnnotation() == kSkipAnnotation) {
+            return false;
+        }
+        if (!FunctionFilter.empty() && (!fn || !filter_.match(fn->getQualifiedNameAsString()))) {
+            return false;
+        }
+        return true;
+    }
+
+    // [[clang::annotate("loop_monitor_skip")]]（LOOP_MONITOR_SKIP）或上一行注释
+    bool isOptedOut(const Stmt* loop, ASTContext& ctx) {
+        for (const auto& parent : ctx.getParents(*loop)) {
+            if (const auto* attributed = parent.get<AttributedStmt>()) {
+                for (const Attr* attr : attributed->getAttrs()) {
+                    if (const auto* annotate = dyn_cast<AnnotateAttr>(attr)) {
+                        if (annotate->getAnnotation() == kSkipAnnotation) return true;
+                    }
+                }
+            }
+        }
+        return precedingText(loop, ctx).contains(kSkipComment);
+    }
+
+    // 已有手写守卫则跳过（重复运行工具是幂等的；包进 {} 的守卫与循环同行，同样能找到）
+    bool alreadyInstrumented(const Stmt* loop, ASTContext& ctx) {
+        const llvm::StringRef before = precedingText(loop, ctx);
+        return before.contains("CHECK_LOOP_DYNAMIC_SIZE(") || before.contains("LOOP_MONITOR_GUARD(") ||
+               before.contains("uint64_t loopCnt_");
+    }
+
+    // 循环前一行加上本行循环之前的源码
+    llvm::StringRef precedingText(const Stmt* loop, ASTContext& ctx) {
+        const SourceManager& sm = ctx.getSourceManager();
+        const auto [fid, offset] = sm.getDecomposedLoc(sm.getExpansionLoc(loop->getBeginLoc()));
+        const llvm::StringRef head = sm.getBufferData(fid).take_front(offset);
+        const size_t lineStart = head.rfind('\n');
+        if (lineStart == llvm::StringRef::npos) return head;
+        const size_t prevStart = head.take_front(lineStart).rfind('\n');
+        return head.drop_front(prevStart == llvm::StringRef::npos ? 0 : prevStart + 1);
+    }
+
+    // 循环是否为复合语句的直接子语句（否则插入的语句需与循环一起包进 {}）
+    bool parentIsCompound(const Stmt* loop, ASTContext& ctx) {
+        for (const auto& parent : ctx.getParents(*loop)) {
+            if (parent.get<CompoundStmt>()) return true;
+        }
+        return false;
+    }
+
+    // 循环末尾之后的位置：循环体为表达式/return 等语句时 getEndLoc 停在分号之前
+    SourceLocation loopEnd(const Stmt* loop, ASTContext& ctx) {
+        const SourceManager& sm = ctx.getSourceManager();
+        const SourceLocation last = sm.getExpansionLoc(loop->getEndLoc());
+        const SourceLocation afterSemi = Lexer::findLocationAfterToken(
+            last, tok::semi, sm, ctx.getLangOpts(), /*SkipTrailingWhitespaceAndNewLine=*/false);
+        return afterSemi.isValid() ? afterSemi : Lexer::getLocForEndOfToken(last, 0, sm, ctx.getLangOpts());
+    }
+
+    const FunctionDecl* enclosingFunction(const Stmt* loop, ASTContext& ctx) {
+        DynTypedNode node = DynTypedNode::create(*loop);
+        for (int depth = 0; depth < 256; ++depth) {
+            const auto parents = ctx.getParents(node);
+            if (parents.empty()) return nullptr;
+            node = parents[0];
+            if (const auto* fn = node.get<FunctionDecl>()) return fn;
+        }
+        return nullptr;
+    }
+
+    static bool isSmallConstant(const Expr* bound, ASTContext& ctx) {
+        Expr::EvalResult result;
+        if (!bound->EvaluateAsInt(result, ctx)) return false;
+        const llvm::APSInt& value = result.Val.getInt();
+        return !value.isNegative() && value.getLimitedValue() < ConstantBoundCutoff;
+    }
+
+    static bool hasSizeMember(QualType type) {
+        const CXXRecordDecl* record = type.getNonReferenceType()->getAsCXXRecordDecl();
+        if (!record || !record->hasDefinition()) return false;
+        for (const auto* method : record->methods()) {
+            if (method->getNameAsString() == "size" && method->getNumParams() == 0) return true;
+        }
+        return false;
+    }
+
+    std::string text(const Expr* e, ASTContext& ctx) {
+        return Lexer::getSourceText(CharSourceRange::getTokenRange(e->getSourceRange()),
+                                    ctx.getSourceManager(), ctx.getLangOpts())
+            .str();
+    }
+
+    std::string siteName(const Stmt* loop, ASTContext& ctx) {
+        const SourceManager& sm = ctx.getSourceManager();
+        const SourceLocation loc = sm.getExpansionLoc(loop->getBeginLoc());
+        std::string name = NamePrefix + llvm::sys::path::filename(sm.getFilename(loc)).str() + ":" +
+                           std::to_string(sm.getExpansionLineNumber(loc)) + ":" +
+                           std::to_string(sm.getExpansionColumnNumber(loc));
+        if (const FunctionDecl* fn = enclosingFunction(loop, ctx)) name += " " + fn->getNameAsString();
+        return name;
+    }
+
+    void insertBefore(const Stmt* loop, const std::string& code, ASTContext& ctx) {
+        const SourceManager& sm = ctx.getSourceManager();
+        const SourceLocation begin = sm.getExpansionLoc(loop->getBeginLoc());
+        const auto [fid, offset] = sm.getDecomposedLoc(begin);
+        const llvm::StringRef buffer = sm.getBufferData(fid);
+        const LoopInstrument::LoopPrologue prologue = LoopInstrument::loopPrologue(
+            code, LoopInstrument::lineIndent(std::string_view(buffer.data(), buffer.size()), offset),
+            parentIsCompound(loop, ctx));
+        rewriter_.InsertTextBefore(begin, prologue.before);
+        if (!prologue.after.empty()) rewriter_.InsertTextAfter(loopEnd(loop, ctx), prologue.after);
+        markFile(loop, ctx);
+    }
+
+    void markFile(const Stmt* loop, ASTContext& ctx) {
+        touched_.insert(ctx.getSourceManager().getFileID(
+            ctx.getSourceManager().getExpansionLoc(loop->getBeginLoc())));
+    }
+
+    Rewriter& rewriter_;
+    llvm::Regex filter_;
+    std::set<unsigned> done_;
+    std::set<FileID> touched_;
+};
+
+class InstrumentConsumer : public ASTConsumer {
+public:
+    explicit InstrumentConsumer(Rewriter& rewriter) : callback_(rewriter) {
+        // 上限/范围表达式会被再求值一次：只接受不含非 const 成员调用的表达式
+        const auto nonConstCall = callExpr(unless(cxxMemberCallExpr(callee(cxxMethodDecl(isConst())))));
+        const auto repeatable = expr(unless(nonConstCall), unless(hasDescendant(nonConstCall)));
+        if (ForLoops) {
+            finder_.addMatcher(
+                forStmt(unless(isInTemplateInstantiation()),
+                        hasCondition(binaryOperator(hasAnyOperatorName("<", "<=", "!="),
+                                                    hasRHS(expr(hasType(isInteger()), repeatable).bind("bound")))
+                                         .bind("cond")))
+                    .bind("for"),
+                &callback_);
+        }
+        if (RangeLoops) {
+            finder_.addMatcher(
+                cxxForRangeStmt(unless(isInTemplateInstantiation()), hasRangeInit(repeatable)).bind("rangeFor"),
+                &callback_);
+        }
+        if (WhileLoops) {
+            finder_.addMatcher(whileStmt(unless(isInTemplateInstantiation())).bind("while"), &callback_);
+        }
+    }
+
+    void HandleTranslationUnit(ASTContext& ctx) override { finder_.matchAST(ctx); }
+
+    const LoopInstrumenter& callback() const { return callback_; }
+
+private:
+    MatchFinder finder_;
+    LoopInstrumenter callback_;
+};
+
+class InstrumentAction : public ASTFrontendAction {
+public:
+    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance& ci, llvm::StringRef) override {
+        rewriter_.setSourceMgr(ci.getSourceManager(), ci.getLangOpts());
+        auto consumer = std::make_unique<InstrumentConsumer>(rewriter_);
+        consumer_ = consumer.get();
+        return consumer;
+    }
+
+    void EndSourceFileAction() override {
+        const SourceManager& sm = rewriter_.getSourceMgr();
+        for (FileID fid : consumer_->callback().touchedFiles()) {
+            const llvm::StringRef buffer = sm.getBufferData(fid);
+            if (!buffer.contains("DynamicLoopCheck.h")) {
+                const LoopInstrument::IncludeInsertion include =
+                    LoopInstrument::includeInsertion(std::string_view(buffer.data(), buffer.size()));
+                rewriter_.InsertTextBefore(sm.getLocForStartOfFile(fid).getLocWithOffset(include.offset),
+                                           include.text);
+            }
+        }
+        if (InPlace) {
+            rewriter_.overwriteChangedFiles();
+        } else {
+            rewriter_.getEditBuffer(sm.getMainFileID()).write(llvm::outs());
+        }
+    }
+
+private:
+    Rewriter rewriter_;
+    InstrumentConsumer* consumer_ = nullptr;
+};
+
+} // namespace
+
+int main(int argc, const char** argv) {
+    auto parser = tooling::CommonOptionsParser::create(argc, argv, ToolCategory);
+    if (!parser) {
+        llvm::errs() << parser.takeError();
+        return 1;
+    }
+    tooling::ClangTool tool(parser->getCompilations(), parser->getSourcePathList());
+    return tool.run(tooling::newFrontendActionFactory<InstrumentAction>().get());
+}
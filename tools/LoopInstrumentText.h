@@ -0,0 +1,98 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// loop-instrument 的文本改写规则：不依赖 Clang，由 tests/LoopInstrumentTextTest.cpp 单独测试
+namespace LoopInstrument {
+
+// for 条件中的上限换算为传给 CHECK_LOOP_DYNAMIC_SIZE 的规模：i <= n 共执行 n + 1 次，
+// 经 LoopMonitor::inclusiveBound 计算（n 为无符号最大值时不回绕为 0，有符号负数仍按负数告警）
+inline std::string loopBoundArgument(std::string_view bound, std::string_view op) {
+    if (op == "<=") return "LoopMonitor::inclusiveBound(" + std::string(bound) + ")";
+    return std::string(bound);
+}
+
+// while 计数器名：行号 + 列号，同一行的多个循环互不冲突
+inline std::string loopCounterName(unsigned line, unsigned column) {
+    return "loopCnt_" + std::to_string(line) + "_" + std::to_string(column);
+}
+
+// offset 所在行的行首缩进
+inline std::string_view lineIndent(std::string_view buffer, size_t offset) {
+    size_t begin = offset;
+    while (begin > 0 && buffer[begin - 1] != '\n') --begin;
+    size_t end = begin;
+    while (end < offset && (buffer[end] == ' ' || buffer[end] == '\t')) ++end;
+    return buffer.substr(begin, end - begin);
+}
+
+// 插在循环前的语句：循环是复合语句的直接子语句时单独成行；否则（if/else/循环体、case/标签之后）
+// 用 {} 把语句与循环一起包起来，避免语句落到 if 之外或 case 跳过计数器的初始化
+struct LoopPrologue {
+    std::string before;   // 插在循环首字符之前
+    std::string after;    // 插在循环末尾（含分号）之后
+};
+
+inline LoopPrologue loopPrologue(std::string_view statement, std::string_view indent, bool parentIsCompound) {
+    if (parentIsCompound) return {std::string(statement) + "\n" + std::string(indent), ""};
+    return {"{ " + std::string(statement) + " ", " }"};
+}
+
+// 补 #include "DynamicLoopCheck.h" 的位置：最外层条件编译中最后一个 #include 之后；
+// 没有 #include 时放在文件开头的注释、空行与 #pragma once 之后
+struct IncludeInsertion {
+    size_t offset;
+    std::string text;
+};
+
+inline IncludeInsertion includeInsertion(std::string_view buffer) {
+    constexpr std::string_view kInclude = "#include \"DynamicLoopCheck.h\"\n";
+    size_t lastInclude = std::string_view::npos;   // 最后一个 #include 行之后的偏移
+    int lastIncludeDepth = 0;
+    size_t preamble = 0;                           // 开头注释/空行/#pragma once 之后的偏移
+    bool inPreamble = true;
+    bool inComment = false;
+    int depth = 0;
+    for (size_t pos = 0; pos < buffer.size();) {
+        size_t eol = buffer.find('\n', pos);
+        const size_t next = eol == std::string_view::npos ? buffer.size() : eol + 1;
+        std::string_view line = buffer.substr(pos, next - pos);
+        const size_t first = line.find_first_not_of(" \t\r\n");
+        line = first == std::string_view::npos ? std::string_view{} : line.substr(first);
+        bool commentLine = inComment;
+        if (inComment) {
+            if (line.find("*/") != std::string_view::npos) inComment = false;
+        } else if (line.starts_with("/*")) {
+            commentLine = true;
+            inComment = line.find("*/", 2) == std::string_view::npos;
+        } else if (line.starts_with("#")) {
+            std::string_view directive = line.substr(1);
+            directive.remove_prefix(std::min(directive.find_first_not_of(" \t"), directive.size()));
+            if (directive.starts_with("if")) {
+                ++depth;
+            } else if (directive.starts_with("endif")) {
+                --depth;
+            } else if (directive.starts_with("include") &&
+                       (lastInclude == std::string_view::npos || depth <= lastIncludeDepth)) {
+                lastInclude = next;
+                lastIncludeDepth = depth;
+            }
+        }
+        if (inPreamble) {
+            if (commentLine || line.empty() || line.starts_with("//") || line.starts_with("#pragma once")) {
+                preamble = next;
+            } else {
+                inPreamble = false;
+            }
+        }
+        pos = next;
+    }
+    const size_t offset = lastInclude != std::string_view::npos ? lastInclude : preamble;
+    // 文件末行没有换行符时先补一个
+    const bool needsNewline = offset > 0 && buffer[offset - 1] != '\n';
+    return {offset, (needsNewline ? "\n" : "") + std::string(kInclude)};
+}
+
+} // namespace LoopInstrument
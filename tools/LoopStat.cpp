@@ -0,0 +1,226 @@
+// loopstat：类 top 的循环监控查看器，只读映射各进程的 /dev/shm/loopmon.<pid>
+// 用法：loopstat [-i 刷新毫秒] [-s rate|iter|viol|maxn|time] [-n 行数] [-1] [pid ...]
+//       不指定 pid 时自动发现所有发布了统计的进程
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "LoopShmStats.h"
+
+namespace {
+
+enum class SortKey { Rate, Iterations, Violations, MaxN, Time };
+
+struct Options {
+    uint64_t intervalMs = 1000;
+    SortKey sortKey = SortKey::Rate;
+    size_t rows = 40;
+    bool once = false;
+    std::vector<int> pids;
+};
+
+struct Process {
+    LoopMonitor::LoopShmReader reader;
+    uint64_t startTimeNs = 0;
+    bool remapped = false;   // 本轮检测到段被删除重建并已重新映射，旧读数作废
+};
+
+struct Row {
+    int pid = 0;
+    LoopMonitor::LoopShmRecordView cur;
+    double callsPerSec = 0;
+    double iterPerSec = 0;
+    uint64_t violationDelta = 0;
+    double timeMsPerSec = 0;
+};
+
+volatile std::sig_atomic_t gStop = 0;
+
+void usage(const char* argv0) {
+    std::fprintf(stderr, "usage: %s [-i interval_ms] [-s rate|iter|viol|maxn|time] [-n rows] [-1] [pid ...]\n",
+                 argv0);
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-i" && i + 1 < argc) {
+            opt.intervalMs = std::max<uint64_t>(100, std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "-n" && i + 1 < argc) {
+            opt.rows = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-s" && i + 1 < argc) {
+            const std::string key = argv[++i];
+            if (key == "rate") opt.sortKey = SortKey::Rate;
+            else if (key == "iter") opt.sortKey = SortKey::Iterations;
+            else if (key == "viol") opt.sortKey = SortKey::Violations;
+            else if (key == "maxn") opt.sortKey = SortKey::MaxN;
+            else if (key == "time") opt.sortKey = SortKey::Time;
+            else return false;
+        } else if (arg == "-1") {
+            opt.once = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            opt.pids.push_back(std::atoi(arg.c_str()));
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 发现 /dev/shm 下的 loopmon.<pid>
+std::vector<int> discoverPids() {
+    std::vector<int> pids;
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return pids;
+    while (dirent* entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, "loopmon.", 8) == 0) pids.push_back(std::atoi(entry->d_name + 8));
+    }
+    closedir(dir);
+    return pids;
+}
+
+// 已退出进程留下的段不再显示
+bool processAlive(int pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+void syncProcesses(const Options& opt, std::map<int, Process>& procs) {
+    const std::vector<int> pids = opt.pids.empty() ? discoverPids() : opt.pids;
+    for (int pid : pids) {
+        if (!processAlive(pid)) continue;
+        auto found = procs.find(pid);
+        if (found != procs.end()) {
+            Process& proc = found->second;
+            proc.remapped = proc.reader.remapIfReplaced(LoopMonitor::loopShmName(pid));
+            if (!proc.reader.isOpen()) procs.erase(found);
+            continue;
+        }
+        Process p;
+        if (p.reader.open(LoopMonitor::loopShmName(pid))) {
+            p.startTimeNs = p.reader.header().startTimeNs;
+            procs.emplace(pid, std::move(p));
+        }
+    }
+    for (auto it = procs.begin(); it != procs.end();) {
+        it = processAlive(it->first) ? std::next(it) : procs.erase(it);
+    }
+}
+
+double sortValue(const Row& r, SortKey key) {
+    switch (key) {
+        case SortKey::Rate: return r.callsPerSec;
+        case SortKey::Iterations: return r.iterPerSec;
+        case SortKey::Violations:
+            return static_cast<double>(r.violationDelta) * 1e12 + static_cast<double>(r.cur.violations);
+        case SortKey::MaxN: return static_cast<double>(r.cur.maxN);
+        case SortKey::Time: return r.timeMsPerSec;
+    }
+    return 0;
+}
+
+const char* humanCount(double v, char* buf, size_t len) {
+    if (v >= 1e9) std::snprintf(buf, len, "%.1fG", v / 1e9);
+    else if (v >= 1e6) std::snprintf(buf, len, "%.1fM", v / 1e6);
+    else if (v >= 1e3) std::snprintf(buf, len, "%.1fK", v / 1e3);
+    else std::snprintf(buf, len, "%.0f", v);
+    return buf;
+}
+
+void printTable(const Options& opt, size_t processCount, const std::vector<Row>& rows, size_t shown) {
+    if (!opt.once) std::fputs("\033[H\033[2J", stdout);
+    std::printf("loopstat - %zu processes, %zu sites, refresh %llums\n\n", processCount, rows.size(),
+                static_cast<unsigned long long>(opt.intervalMs));
+    std::printf("%7s %-36s %9s %9s %7s %9s %9s %10s %9s %6s\n", "PID", "SITE", "CALLS/s", "ITER/s", "+VIOL",
+                "VIOL", "MAXN", "TIME ms/s", "THRESH", "RATE");
+    char b1[32], b2[32], b3[32], b4[32];
+    for (size_t i = 0; i < shown; ++i) {
+        const Row& r = rows[i];
+        std::printf("%7d %-36.36s %9s %9s %7llu %9llu %9s %10.2f %9s %6u\n", r.pid, r.cur.name,
+                    humanCount(r.callsPerSec, b1, sizeof(b1)), humanCount(r.iterPerSec, b2, sizeof(b2)),
+                    static_cast<unsigned long long>(r.violationDelta),
+                    static_cast<unsigned long long>(r.cur.violations),
+                    humanCount(static_cast<double>(r.cur.maxN), b3, sizeof(b3)), r.timeMsPerSec,
+                    r.cur.threshold ? humanCount(static_cast<double>(r.cur.threshold), b4, sizeof(b4)) : "global",
+                    r.cur.sampleRate);
+    }
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::signal(SIGINT, [](int) { gStop = 1; });
+    std::signal(SIGTERM, [](int) { gStop = 1; });
+
+    std::map<int, Process> procs;
+    // 上一轮读数：键为 (pid << 32) | siteId
+    std::unordered_map<uint64_t, LoopMonitor::LoopShmRecordView> prev;
+    std::unordered_map<uint64_t, LoopMonitor::LoopShmRecordView> next;
+    std::vector<Row> rows;
+    auto lastTick = std::chrono::steady_clock::now();
+    bool first = true;
+
+    while (!gStop) {
+        syncProcesses(opt, procs);
+        const auto now = std::chrono::steady_clock::now();
+        const double elapsedSec = std::max(1e-3, std::chrono::duration<double>(now - lastTick).count());
+        lastTick = now;
+
+        rows.clear();
+        next.clear();
+        for (auto& [pid, proc] : procs) {
+            // 同 pid 进程重启：段被删除重建（已重新映射）或被新进程截断重用（startTimeNs 变化）时
+            // 丢弃旧读数，避免出现负增量
+            const bool restarted = proc.remapped || proc.reader.header().startTimeNs != proc.startTimeNs;
+            proc.remapped = false;
+            proc.startTimeNs = proc.reader.header().startTimeNs;
+            const uint32_t count = proc.reader.siteCount();
+            for (uint32_t i = 0; i < count; ++i) {
+                Row row;
+                row.pid = pid;
+                if (!proc.reader.read(i, row.cur)) continue;
+                const uint64_t key = (static_cast<uint64_t>(pid) << 32) | row.cur.siteId;
+                auto it = prev.find(key);
+                if (it != prev.end() && !restarted) {
+                    const auto& old = it->second;
+                    row.callsPerSec = static_cast<double>(row.cur.invocations - old.invocations) / elapsedSec;
+                    row.iterPerSec = static_cast<double>(row.cur.iterations - old.iterations) / elapsedSec;
+                    row.violationDelta = row.cur.violations - old.violations;
+                    row.timeMsPerSec = static_cast<double>(row.cur.totalNs - old.totalNs) / 1e6 / elapsedSec;
+                }
+                next.emplace(key, row.cur);
+                rows.push_back(row);
+            }
+        }
+        prev.swap(next);
+
+        const size_t shown = std::min(opt.rows, rows.size());
+        std::partial_sort(rows.begin(), rows.begin() + static_cast<std::ptrdiff_t>(shown), rows.end(),
+                          [&](const Row& a, const Row& b) {
+                              return sortValue(a, opt.sortKey) > sortValue(b, opt.sortKey);
+                          });
+
+        // -1 模式需要两次读数才能得到增量，第一轮只采样不输出
+        if (!(opt.once && first)) {
+            printTable(opt, procs.size(), rows, shown);
+            if (opt.once) break;
+        }
+        first = false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(opt.intervalMs));
+    }
+    return 0;
+}